@@ -0,0 +1,234 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _ARENA_HPP_
+#define _ARENA_HPP_
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <stddef.h>
+
+/* A monotonic arena for the many small objects which make up the plan of a
+   decomposition. Allocations are carved out of large blocks and never freed
+   individually; the whole arena is released in one go when it is
+   destroyed, so a long batch or server run doesn't fragment the heap with
+   the leftovers of each model. Not thread safe. */
+class Arena
+{
+public:
+  Arena(size_t blockSize = 64*1024);
+  ~Arena();
+  void* allocate(size_t size,size_t align);
+  /* the total size of the blocks allocated */
+  size_t size() const
+  {
+    return mSize;
+  }
+private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  size_t mBlockSize;
+  std::vector<char*> mBlocks;
+  char* mNext;
+  size_t mRemaining;
+  size_t mSize;
+};
+
+/* A standard allocator for node based containers, which keeps their nodes
+   in an arena. Only single objects come from the arena, since they are
+   never given back; arrays, such as the buckets of a hash table, come from
+   the heap and are freed as usual when the container grows, so they don't
+   leave a trail of old copies in the arena. Lists which grow an item at a
+   time should be ArenaLists instead. */
+template<class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  ArenaAllocator(Arena& arena) : mArena(&arena)
+  {
+  }
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.arena())
+  {
+  }
+  T* allocate(size_t n)
+  {
+    if (n != 1) return static_cast<T*>(::operator new(n*sizeof(T)));
+    return static_cast<T*>(mArena->allocate(sizeof(T),alignof(T)));
+  }
+  void deallocate(T* p,size_t n)
+  {
+    if (n != 1) ::operator delete(p);
+  }
+  Arena* arena() const
+  {
+    return mArena;
+  }
+private:
+  Arena* mArena;
+};
+
+template<class T,class U>
+bool operator==(const ArenaAllocator<T>& lhs,const ArenaAllocator<U>& rhs)
+{
+  return (lhs.arena() == rhs.arena());
+}
+
+template<class T,class U>
+bool operator!=(const ArenaAllocator<T>& lhs,const ArenaAllocator<U>& rhs)
+{
+  return (lhs.arena() != rhs.arena());
+}
+
+/* An append-only list kept in an arena. The items are stored in chunks,
+   each twice the size of the one before, which never move once allocated,
+   so the list can grow without copying anything or leaving old copies in
+   the arena. The items are never destroyed, so mustn't own anything which
+   isn't in the arena themselves. */
+#define ARENA_LIST_FIRST_CHUNK 4
+
+template<class T>
+class ArenaList
+{
+  static_assert(std::is_trivially_destructible<T>::value,
+    "ArenaList items are never destroyed");
+  class Chunk
+  {
+  public:
+    Chunk* next;
+    size_t size;
+    size_t capacity;
+    T* items;
+  };
+public:
+  class const_iterator
+  {
+  public:
+    const_iterator(const Chunk* chunk,size_t i) : mChunk(chunk), mI(i)
+    {
+    }
+    const T& operator*() const
+    {
+      return mChunk->items[mI];
+    }
+    const T* operator->() const
+    {
+      return &(mChunk->items[mI]);
+    }
+    const_iterator& operator++()
+    {
+      // chunks are only added when there is an item to go in them
+      if (++mI == mChunk->size)
+      {
+        mChunk = mChunk->next;
+        mI = 0;
+      }
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const
+    {
+      return ((mChunk == other.mChunk) && (mI == other.mI));
+    }
+    bool operator!=(const const_iterator& other) const
+    {
+      return !(*this == other);
+    }
+  private:
+    const Chunk* mChunk;
+    size_t mI;
+  };
+  ArenaList(Arena& arena) : mArena(&arena), mFirst(NULL), mLast(NULL),
+    mSize(0)
+  {
+  }
+  /* add a new item to the end of the list, made from the given arguments */
+  template<class... Args>
+  T& emplace_back(Args&&... args)
+  {
+    if ((mLast == NULL) || (mLast->size == mLast->capacity)) grow();
+    T* item = new(mLast->items + mLast->size) T(std::forward<Args>(args)...);
+    mLast->size++;
+    mSize++;
+    return *item;
+  }
+  void push_back(const T& item)
+  {
+    emplace_back(item);
+  }
+  const_iterator begin() const
+  {
+    return const_iterator(mFirst,0);
+  }
+  const_iterator end() const
+  {
+    return const_iterator(NULL,0);
+  }
+  size_t size() const
+  {
+    return mSize;
+  }
+  bool empty() const
+  {
+    return (mSize == 0);
+  }
+private:
+  void grow()
+  {
+    size_t capacity = mLast ? 2*mLast->capacity : ARENA_LIST_FIRST_CHUNK;
+    Chunk* chunk =
+      static_cast<Chunk*>(mArena->allocate(sizeof(Chunk),alignof(Chunk)));
+    chunk->next = NULL;
+    chunk->size = 0;
+    chunk->capacity = capacity;
+    chunk->items =
+      static_cast<T*>(mArena->allocate(capacity*sizeof(T),alignof(T)));
+    if (mLast) mLast->next = chunk;
+    else mFirst = chunk;
+    mLast = chunk;
+  }
+  ArenaList(const ArenaList&);
+  ArenaList& operator=(const ArenaList&);
+
+  Arena* mArena;
+  Chunk* mFirst;
+  Chunk* mLast;
+  size_t mSize;
+};
+
+#endif /* _ARENA_HPP_ */
@@ -0,0 +1,282 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+/* Generate synthetic CellML 1.0 models for benchmarking decompose. The
+   size and shape of the model are controlled from the command line so the
+   cost of each phase can be measured along each scaling axis. */
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The shape of the model to generate */
+class ModelShape
+{
+public:
+  ModelShape() : components(10), variables(5), parameters(5), states(2),
+    density(0.2), units(5), seed(1)
+  {
+  }
+  // the number of components, not counting the environment
+  int components;
+  // computed variables per component
+  int variables;
+  // parameters per component
+  int parameters;
+  // state variables per component
+  int states;
+  // the probability of each pair of components being connected
+  double density;
+  // the number of units definitions
+  int units;
+  unsigned int seed;
+};
+
+/* a small, repeatable random number generator so the same options always
+   give the same model */
+static unsigned int nextRandom(unsigned int& state)
+{
+  state = state*1103515245 + 12345;
+  return (state >> 16) & 0x7fff;
+}
+
+static std::string unitsName(const ModelShape& shape,int i)
+{
+  if (shape.units < 1) return "dimensionless";
+  char name[32];
+  sprintf(name,"units_%d",i % shape.units);
+  return name;
+}
+
+static void ci(FILE* f,const char* name)
+{
+  fprintf(f,"          <ci>%s</ci>\n",name);
+}
+
+static void writeModel(FILE* f,const ModelShape& shape)
+{
+  fprintf(f,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(f,"<model xmlns=\"http://www.cellml.org/cellml/1.0#\" "
+    "xmlns:cellml=\"http://www.cellml.org/cellml/1.0#\" "
+    "name=\"synthetic_%d_%d_%d_%d_%d\">\n",shape.components,shape.variables,
+    shape.parameters,shape.states,shape.units);
+  for (int u=0;u<shape.units;++u)
+  {
+    fprintf(f,"  <units name=\"units_%d\">\n",u);
+    fprintf(f,"    <unit units=\"second\" exponent=\"%d\"/>\n",-(u+1));
+    fprintf(f,"  </units>\n");
+  }
+  fprintf(f,"  <component name=\"environment\">\n");
+  fprintf(f,"    <variable name=\"time\" units=\"second\" "
+    "public_interface=\"out\"/>\n");
+  fprintf(f,"  </component>\n");
+  /* work out the connections first, always from a lower numbered component
+     to a higher one so there are no algebraic loops */
+  unsigned int random = shape.seed;
+  std::vector< std::vector<int> > inputs(shape.components);
+  for (int i=0;i<shape.components;++i)
+  {
+    for (int j=i+1;j<shape.components;++j)
+    {
+      if (nextRandom(random) < shape.density*32768.0)
+        inputs[j].push_back(i);
+    }
+  }
+  char name[64], other[64];
+  for (int c=0;c<shape.components;++c)
+  {
+    fprintf(f,"  <component name=\"component_%d\">\n",c);
+    fprintf(f,"    <variable name=\"time\" units=\"second\" "
+      "public_interface=\"in\"/>\n");
+    for (int s=0;s<shape.states;++s)
+    {
+      fprintf(f,"    <variable name=\"state_%d\" units=\"%s\" "
+        "initial_value=\"%d.5\" public_interface=\"out\"/>\n",s,
+        unitsName(shape,s).c_str(),s);
+    }
+    for (int p=0;p<shape.parameters;++p)
+    {
+      fprintf(f,"    <variable name=\"parameter_%d\" units=\"%s\" "
+        "initial_value=\"%d.25\"/>\n",p,unitsName(shape,p).c_str(),p+1);
+    }
+    for (int v=0;v<shape.variables;++v)
+    {
+      fprintf(f,"    <variable name=\"variable_%d\" units=\"%s\" "
+        "public_interface=\"out\"/>\n",v,unitsName(shape,v).c_str());
+    }
+    for (size_t i=0;i<inputs[c].size();++i)
+    {
+      fprintf(f,"    <variable name=\"input_%d\" units=\"%s\" "
+        "public_interface=\"in\"/>\n",inputs[c][i],
+        unitsName(shape,0).c_str());
+    }
+    fprintf(f,"    <math xmlns=\"http://www.w3.org/1998/Math/MathML\">\n");
+    // each state variable decays towards one of the computed variables
+    for (int s=0;s<shape.states;++s)
+    {
+      sprintf(name,"state_%d",s);
+      fprintf(f,"      <apply><eq/>\n");
+      fprintf(f,"        <apply><diff/><bvar><ci>time</ci></bvar>"
+        "<ci>%s</ci></apply>\n",name);
+      fprintf(f,"        <apply><minus/>\n");
+      if (shape.variables > 0)
+      {
+        sprintf(other,"variable_%d",s % shape.variables);
+        ci(f,other);
+      }
+      else fprintf(f,"          <cn cellml:units=\"dimensionless\">0"
+        "</cn>\n");
+      ci(f,name);
+      fprintf(f,"        </apply>\n");
+      fprintf(f,"      </apply>\n");
+    }
+    // each computed variable is a sum of the parameters, states and inputs
+    for (int v=0;v<shape.variables;++v)
+    {
+      fprintf(f,"      <apply><eq/>\n");
+      fprintf(f,"        <ci>variable_%d</ci>\n",v);
+      fprintf(f,"        <apply><plus/>\n");
+      fprintf(f,"          <cn cellml:units=\"%s\">%d</cn>\n",
+        unitsName(shape,v).c_str(),v);
+      if (shape.parameters > 0)
+      {
+        sprintf(other,"parameter_%d",v % shape.parameters);
+        ci(f,other);
+      }
+      // only the first variable depends on the states, avoiding loops
+      if ((v == 0) && (shape.states > 0)) ci(f,"state_0");
+      if (v == 0)
+      {
+        for (size_t i=0;i<inputs[c].size();++i)
+        {
+          sprintf(other,"input_%d",inputs[c][i]);
+          ci(f,other);
+        }
+      }
+      fprintf(f,"        </apply>\n");
+      fprintf(f,"      </apply>\n");
+    }
+    fprintf(f,"    </math>\n");
+    fprintf(f,"  </component>\n");
+  }
+  /* connect every component to the environment and each input to the
+     first computed variable of the component it comes from */
+  for (int c=0;c<shape.components;++c)
+  {
+    fprintf(f,"  <connection>\n");
+    fprintf(f,"    <map_components component_1=\"environment\" "
+      "component_2=\"component_%d\"/>\n",c);
+    fprintf(f,"    <map_variables variable_1=\"time\" "
+      "variable_2=\"time\"/>\n");
+    fprintf(f,"  </connection>\n");
+  }
+  for (int c=0;c<shape.components;++c)
+  {
+    for (size_t i=0;i<inputs[c].size();++i)
+    {
+      if (shape.variables < 1) continue;
+      fprintf(f,"  <connection>\n");
+      fprintf(f,"    <map_components component_1=\"component_%d\" "
+        "component_2=\"component_%d\"/>\n",inputs[c][i],c);
+      fprintf(f,"    <map_variables variable_1=\"variable_0\" "
+        "variable_2=\"input_%d\"/>\n",inputs[c][i]);
+      fprintf(f,"  </connection>\n");
+    }
+  }
+  fprintf(f,"</model>\n");
+}
+
+void usage(const char* prog)
+{
+  printf("Usage: %s [options] [output.xml]\n",prog);
+  printf("\n  Writes a synthetic CellML 1.0 model to the given file, or "
+    "stdout.\n");
+  printf("\nOptions:\n");
+  printf("  --components N  number of components (10)\n");
+  printf("  --variables N   computed variables per component (5)\n");
+  printf("  --parameters N  parameters per component (5)\n");
+  printf("  --states N      state variables per component (2)\n");
+  printf("  --density F     probability of connecting each pair of "
+    "components (0.2)\n");
+  printf("  --units N       number of units definitions (5)\n");
+  printf("  --seed N        random number seed (1)\n");
+}
+
+int main(int argc,char** argv)
+{
+  ModelShape shape;
+  const char* output = NULL;
+  for (int i=1;i<argc;++i)
+  {
+    if ((strncmp(argv[i],"--",2) == 0) && (i+1 < argc))
+    {
+      const char* option = argv[i] + 2;
+      const char* value = argv[++i];
+      if (strcmp(option,"components") == 0) shape.components = atoi(value);
+      else if (strcmp(option,"variables") == 0) shape.variables = atoi(value);
+      else if (strcmp(option,"parameters") == 0)
+        shape.parameters = atoi(value);
+      else if (strcmp(option,"states") == 0) shape.states = atoi(value);
+      else if (strcmp(option,"density") == 0) shape.density = atof(value);
+      else if (strcmp(option,"units") == 0) shape.units = atoi(value);
+      else if (strcmp(option,"seed") == 0) shape.seed = atoi(value);
+      else
+      {
+        usage(argv[0]);
+        return -1;
+      }
+    }
+    else if ((argv[i][0] != '-') && (output == NULL)) output = argv[i];
+    else
+    {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  FILE* f = stdout;
+  if (output)
+  {
+    f = fopen(output,"w");
+    if (f == NULL)
+    {
+      printf("Unable to open output file: %s\n",output);
+      return -1;
+    }
+  }
+  writeModel(f,shape);
+  if (output) fclose(f);
+  return 0;
+}
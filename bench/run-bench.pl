@@ -0,0 +1,70 @@
+eval 'exec perl -w -S $0 ${1+"$@"}'
+    if 0;
+
+# Run decompose over synthetic models of increasing size along each scaling
+# axis and tabulate the time taken by each phase, as reported by
+# decompose --profile. Usage:
+#
+#   run-bench.pl decompose genmodel workDir [axis ...]
+#
+# where each axis is one of components, variables, parameters, states,
+# density or units (default all of them). Output is tab separated with a
+# row for each model.
+
+use strict;
+use JSON::PP;
+
+if (scalar @ARGV < 3) {
+  print "Usage: $0 decompose genmodel workDir [axis ...]\n";
+  exit(1);
+}
+my $decompose = shift;
+my $genmodel = shift;
+my $work = shift;
+
+# the sizes to try along each axis, the other axes keep their defaults
+my %axes = (
+  components => [10, 50, 100, 200, 400, 800],
+  variables => [2, 10, 50, 100, 200],
+  parameters => [2, 10, 50, 100, 200],
+  states => [1, 5, 25, 50, 100],
+  density => [0.0, 0.1, 0.25, 0.5, 1.0],
+  units => [0, 10, 100, 500, 1000]
+);
+my @order = qw(components variables parameters states density units);
+my @axes = scalar @ARGV ? @ARGV : @order;
+my @phases = qw(loadFromURL fullyInstantiateImports createCeVAS
+  classifyVariables buildIndex planComponents importComponentNodes
+  buildComponents applySharedUpdates addUnits createUnitsImports
+  createConnections dump);
+my @counters = qw(storeConnection importNode bytesWritten);
+
+mkdir $work unless -d $work;
+print join("\t", "axis", "value", "total_ms", @phases, @counters), "\n";
+foreach my $axis (@axes) {
+  die "Unknown axis: $axis\n" unless exists $axes{$axis};
+  foreach my $value (@{$axes{$axis}}) {
+    my $model = "$work/$axis-$value.xml";
+    my $out = "$work/$axis-$value";
+    my $report = "$work/$axis-$value.json";
+    mkdir $out unless -d $out;
+    system($genmodel, "--$axis", $value, $model) == 0
+      or die "Unable to generate model: $model\n";
+    system("$decompose --profile $report file://$model $out > /dev/null") == 0
+      or die "Unable to decompose model: $model\n";
+    open(REPORT, "<$report") or die "Unable to open report ($report): $!\n";
+    my $json = decode_json(join("", <REPORT>));
+    close REPORT;
+    my %wall;
+    my $total = 0;
+    foreach my $phase (@{$json->{phases}}) {
+      $wall{$phase->{name}} = $phase->{wall_ms};
+      # these are nested within other phases
+      $total += $phase->{wall_ms}
+        unless $phase->{name} =~ /^(generateCode|fetchImports)$/;
+    }
+    print join("\t", $axis, $value, sprintf("%.3f", $total),
+      (map { sprintf("%.3f", $wall{$_} || 0) } @phases),
+      (map { $json->{counters}->{$_} } @counters)), "\n";
+  }
+}
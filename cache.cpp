@@ -0,0 +1,378 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "cache.hpp"
+#include "strings.hpp"
+#include "version.hpp"
+
+#define CACHE_SUFFIX ".analysis"
+
+typedef std::map< std::wstring,ObjRef<iface::cellml_api::CellMLComponent> >
+  ComponentMap;
+typedef std::map< std::string,ObjRef<iface::cellml_api::CellMLComponent> >
+  ComponentPaths;
+
+/* hash the DOM of the given model and all the models it imports */
+static ContentHash hashModel(iface::cellml_api::Model* model,
+  ContentHash hash)
+{
+  DECLARE_QUERY_INTERFACE(modelDE,model,cellml_api::CellMLDOMElement);
+  if (modelDE)
+  {
+    RETURN_INTO_OBJREF(modelElement,iface::dom::Element,
+      modelDE->domElement());
+    modelDE->release_ref();
+    hash = hashNode(modelElement,hash);
+  }
+  RETURN_INTO_OBJREF(imports,iface::cellml_api::CellMLImportSet,
+    model->imports());
+  RETURN_INTO_OBJREF(ii,iface::cellml_api::CellMLImportIterator,
+    imports->iterateImports());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(imp,iface::cellml_api::CellMLImport,ii->nextImport());
+    if (imp == NULL) break;
+    RETURN_INTO_OBJREF(im,iface::cellml_api::Model,imp->importedModel());
+    if (im) hash = hashModel(im,hash);
+  }
+  return hash;
+}
+
+/* find all the components defined in the model and the models it imports,
+   by their path: the positions of the imports leading to the model they
+   are defined in and then their position among that model's own
+   components, e.g. "0/2/5". Unlike their names, these are unique. */
+static void mapComponentPaths(iface::cellml_api::Model* model,
+  const std::string& prefix,ComponentPaths& paths)
+{
+  RETURN_INTO_OBJREF(cs,iface::cellml_api::CellMLComponentSet,
+    model->localComponents());
+  RETURN_INTO_OBJREF(ci,iface::cellml_api::CellMLComponentIterator,
+    cs->iterateComponents());
+  for (int i=0;;++i)
+  {
+    RETURN_INTO_OBJREF(c,iface::cellml_api::CellMLComponent,
+      ci->nextComponent());
+    if (c == NULL) break;
+    std::ostringstream path;
+    path << prefix << i;
+    paths[path.str()] = c;
+  }
+  RETURN_INTO_OBJREF(imports,iface::cellml_api::CellMLImportSet,
+    model->imports());
+  RETURN_INTO_OBJREF(ii,iface::cellml_api::CellMLImportIterator,
+    imports->iterateImports());
+  for (int i=0;;++i)
+  {
+    RETURN_INTO_OBJREF(imp,iface::cellml_api::CellMLImport,ii->nextImport());
+    if (imp == NULL) break;
+    RETURN_INTO_OBJREF(im,iface::cellml_api::Model,imp->importedModel());
+    std::ostringstream path;
+    path << prefix << i << "/";
+    if (im) mapComponentPaths(im,path.str(),paths);
+  }
+}
+
+/* find the named variable in the named component */
+static iface::cellml_api::CellMLVariable*
+findVariable(const ComponentMap& components,const std::wstring& cname,
+  const std::wstring& name)
+{
+  ComponentMap::const_iterator c = components.find(cname);
+  if (c == components.end()) return NULL;
+  RETURN_INTO_OBJREF(vs,iface::cellml_api::CellMLVariableSet,
+    c->second->variables());
+  return vs->getVariable(name.c_str());
+}
+
+AnalysisCache::AnalysisCache(const std::string& dir,long limit) :
+  mDir(dir), mLimit(limit), mHits(0), mMisses(0), mStores(0), mEvictions(0),
+  mSequence(0)
+{
+}
+
+ContentHash AnalysisCache::key(iface::cellml_api::Model* model,
+  ClassifierMode mode)
+{
+  ContentHash hash = hashString(string2wstring(getVersion().c_str()));
+  hash = hashBytes(&mode,sizeof(mode),hash);
+  return hashModel(model,hash);
+}
+
+std::string AnalysisCache::entryFile(ContentHash key) const
+{
+  char name[32];
+  sprintf(name,"%016" PRIx64,key);
+  return mDir + "/" + name + CACHE_SUFFIX;
+}
+
+bool AnalysisCache::load(ContentHash key,iface::cellml_api::Model* model,
+  VariableRoleIndex& index)
+{
+  std::string file = entryFile(key);
+  std::ifstream in(file.c_str());
+  if (!in)
+  {
+    mMisses++;
+    return false;
+  }
+  ComponentPaths allComponents;
+  mapComponentPaths(model,"",allComponents);
+  // the relevant components by name, which the variables refer to
+  ComponentMap relevant;
+  std::vector< ObjRef<iface::cellml_api::CellMLComponent> > components;
+  VariableList stateVariables, boundVariables;
+  std::vector<VariableNameList> sets;
+  bool ok = true;
+  std::string line;
+  while (ok && std::getline(in,line))
+  {
+    // component path name | state|bound component variable |
+    // set | variable component variable
+    std::istringstream fields(line);
+    std::string type, cname, name;
+    if (!(fields >> type) || (type[0] == '#')) continue;
+    if (type == "set")
+    {
+      sets.push_back(VariableNameList());
+      continue;
+    }
+    if (!(fields >> cname)) ok = false;
+    else if (!(fields >> name)) ok = false;
+    else if (type == "component")
+    {
+      /* the component at the path must still have the same name, and the
+         relevant components' names must be unique for the variables to be
+         found by name */
+      ComponentPaths::const_iterator c = allComponents.find(cname);
+      std::wstring wname = string2wstring(name.c_str());
+      if (c == allComponents.end()) ok = false;
+      else
+      {
+        RETURN_INTO_WSTRING(actual,c->second->name());
+        if ((actual != wname) || relevant.count(wname)) ok = false;
+        else
+        {
+          relevant[wname] = c->second;
+          components.push_back(c->second);
+        }
+      }
+    }
+    else if ((type == "state") || (type == "bound"))
+    {
+      RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+        findVariable(relevant,string2wstring(cname.c_str()),
+          string2wstring(name.c_str())));
+      if (v == NULL) ok = false;
+      else if (type == "state") stateVariables.push_back(std::move(v));
+      else boundVariables.push_back(std::move(v));
+    }
+    else if ((type == "variable") && !sets.empty())
+    {
+      sets.back().push_back(VariableName(string2wstring(cname.c_str()),
+          string2wstring(name.c_str())));
+    }
+    else ok = false;
+  }
+  if (!ok)
+  {
+    std::cerr << "Ignoring invalid analysis cache entry: " << file
+              << std::endl;
+    remove(file.c_str());
+    mMisses++;
+    return false;
+  }
+  index.build(components,stateVariables,boundVariables,sets);
+  // mark the entry as recently used
+  utime(file.c_str(),NULL);
+  mHits++;
+  return true;
+}
+
+static void writeVariables(FILE* f,const char* type,
+  const VariableList& variables)
+{
+  VariableList::const_iterator i = variables.begin();
+  for (;i!=variables.end();++i)
+  {
+    RETURN_INTO_WSTRING(cname,(*i)->componentName());
+    RETURN_INTO_WSTRING(name,(*i)->name());
+    fprintf(f,"%s %s %s\n",type,narrow(cname).c_str(),narrow(name).c_str());
+  }
+}
+
+/* can all the given variables be found in the named components? */
+static bool inComponents(const VariableList& variables,
+  const std::set<std::wstring>& names)
+{
+  VariableList::const_iterator i = variables.begin();
+  for (;i!=variables.end();++i)
+  {
+    RETURN_INTO_WSTRING(cname,(*i)->componentName());
+    if (names.count(cname) == 0) return false;
+  }
+  return true;
+}
+
+bool AnalysisCache::store(ContentHash key,iface::cellml_api::Model* model,
+  const VariableRoleIndex& index,const VariableList& stateVariables,
+  const VariableList& boundVariables)
+{
+  /* only store what load() can find again exactly: every relevant component
+     by its path, with a unique name, and the state variables and variables
+     of integration in those components */
+  ComponentPaths allComponents;
+  mapComponentPaths(model,"",allComponents);
+  std::map<iface::cellml_api::CellMLComponent*,std::string> paths;
+  ComponentPaths::const_iterator p = allComponents.begin();
+  for (;p!=allComponents.end();++p) paths[p->second] = p->first;
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+    components = index.components();
+  std::vector<std::string> componentPaths;
+  std::set<std::wstring> names;
+  for (size_t i=0;i<components.size();++i)
+  {
+    std::map<iface::cellml_api::CellMLComponent*,std::string>::const_iterator
+      path = paths.find(components[i]);
+    RETURN_INTO_WSTRING(cname,components[i]->name());
+    if ((path == paths.end()) || !names.insert(cname).second) return false;
+    componentPaths.push_back(path->second);
+  }
+  if (!inComponents(stateVariables,names) ||
+    !inComponents(boundVariables,names))
+    return false;
+
+  // write to a temporary file and move it into place, so concurrent runs
+  // never see a partial entry
+  std::string file = entryFile(key);
+  std::ostringstream tmp;
+  tmp << file << ".tmp" << getpid() << "." << mSequence++;
+  FILE* f = fopen(tmp.str().c_str(),"w");
+  if (f == NULL)
+  {
+    std::cerr << "Unable to write analysis cache entry: " << file
+              << std::endl;
+    return false;
+  }
+  fprintf(f,"# decompose analysis cache: %s\n",getVersion().c_str());
+  for (size_t i=0;i<components.size();++i)
+  {
+    RETURN_INTO_WSTRING(cname,components[i]->name());
+    fprintf(f,"component %s %s\n",componentPaths[i].c_str(),
+      narrow(cname).c_str());
+  }
+  writeVariables(f,"state",stateVariables);
+  writeVariables(f,"bound",boundVariables);
+  std::vector<VariableNameList> sets;
+  index.connectedSets(sets);
+  std::vector<VariableNameList>::const_iterator s = sets.begin();
+  for (;s!=sets.end();++s)
+  {
+    fprintf(f,"set\n");
+    VariableNameList::const_iterator n = s->begin();
+    for (;n!=s->end();++n)
+    {
+      fprintf(f,"variable %s %s\n",narrow(n->first).c_str(),
+        narrow(n->second).c_str());
+    }
+  }
+  bool ok = (fclose(f) == 0) && (rename(tmp.str().c_str(),file.c_str()) == 0);
+  if (!ok)
+  {
+    remove(tmp.str().c_str());
+    return false;
+  }
+  mStores++;
+  evict();
+  return true;
+}
+
+void AnalysisCache::evict()
+{
+  std::lock_guard<std::mutex> lock(mEvictMutex);
+  DIR* dir = opendir(mDir.c_str());
+  if (dir == NULL) return;
+  // find all the entries, oldest first
+  std::vector< std::pair<time_t,std::string> > entries;
+  std::map<std::string,long> sizes;
+  long total = 0;
+  struct dirent* de;
+  std::string suffix = CACHE_SUFFIX;
+  while ((de = readdir(dir)) != NULL)
+  {
+    std::string name = de->d_name;
+    if ((name.size() <= suffix.size()) ||
+      (name.compare(name.size()-suffix.size(),suffix.size(),suffix) != 0))
+      continue;
+    std::string file = mDir + "/" + name;
+    struct stat sb;
+    if (stat(file.c_str(),&sb) != 0) continue;
+    entries.push_back(std::make_pair(sb.st_mtime,file));
+    sizes[file] = sb.st_size;
+    total += sb.st_size;
+  }
+  closedir(dir);
+  std::sort(entries.begin(),entries.end());
+  // keep at least the newest entry
+  for (size_t i=0;(total > mLimit) && (i+1<entries.size());++i)
+  {
+    if (remove(entries[i].second.c_str()) != 0) continue;
+    total -= sizes[entries[i].second];
+    mEvictions++;
+  }
+}
+
+void AnalysisCache::report() const
+{
+  std::cout << "Analysis cache: " << mHits << " hits, " << mMisses
+            << " misses, " << mStores << " stored, " << mEvictions
+            << " evicted" << std::endl;
+}
@@ -0,0 +1,100 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _CACHE_HPP_
+#define _CACHE_HPP_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "decompose.hpp"
+#include "manifest.hpp"
+#include "roles.hpp"
+
+/* An on-disk cache of the results of analysing a model: the relevant
+   components, the state variables and variables of integration and the
+   sets of connected variables. Entries are keyed by a hash of the fully
+   instantiated model, the classifier and the version of decompose, so a
+   cache hit lets us skip creating the CeVAS and classifying the variables
+   altogether. Each entry is a small text file in the cache directory and
+   the least recently used entries are evicted to keep the cache under its
+   size limit. The cache can be shared by models being decomposed at the
+   same time. */
+class AnalysisCache
+{
+public:
+  AnalysisCache(const std::string& dir,long limit);
+  /* the cache key for the given (fully instantiated) model */
+  ContentHash key(iface::cellml_api::Model* model,ClassifierMode mode);
+  /* fill in the index from the cache entry for the given key, returning
+     false if there is no usable entry */
+  bool load(ContentHash key,iface::cellml_api::Model* model,
+    VariableRoleIndex& index);
+  /* save the analysis results for the given model under the given key.
+     The relevant components are saved by their position in the model's
+     import tree, and nothing is saved if their names aren't unique. */
+  bool store(ContentHash key,iface::cellml_api::Model* model,
+    const VariableRoleIndex& index,const VariableList& stateVariables,
+    const VariableList& boundVariables);
+  /* print the cache statistics */
+  void report() const;
+  int hits() const
+  {
+    return mHits;
+  }
+  int misses() const
+  {
+    return mMisses;
+  }
+private:
+  std::string entryFile(ContentHash key) const;
+  void evict();
+
+  std::string mDir;
+  long mLimit;
+  std::atomic<int> mHits;
+  std::atomic<int> mMisses;
+  std::atomic<int> mStores;
+  std::atomic<int> mEvictions;
+  // distinguishes the temporary files of concurrent stores
+  std::atomic<int> mSequence;
+  std::mutex mEvictMutex;
+};
+
+#endif /* _CACHE_HPP_ */
@@ -0,0 +1,306 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <set>
+#include <utility>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCCGS.hxx>
+#include <CeVASBootstrap.hpp>
+
+#include "utils.hxx"
+#include "classify.hpp"
+#include "namespaces.hpp"
+#include "strings.hpp"
+#include "profile.hpp"
+
+
+/* is the given node a MathML element with the given local name? */
+static bool isMathMLElement(iface::dom::Node* node,const wchar_t* name)
+{
+  if (node->nodeType() != iface::dom::Node::ELEMENT_NODE) return false;
+  RETURN_INTO_WSTRING(ns,node->namespaceURI());
+  if (ns != MATHML_NS) return false;
+  RETURN_INTO_WSTRING(localName,node->localName());
+  return (localName == name);
+}
+
+/* get the first child element of the given node, or the first sibling
+   element following it if next is true */
+static iface::dom::Node* nextElement(iface::dom::Node* node,bool next)
+{
+  iface::dom::Node* n = next ? node->nextSibling() : node->firstChild();
+  while (n && (n->nodeType() != iface::dom::Node::ELEMENT_NODE))
+  {
+    iface::dom::Node* tmp = n->nextSibling();
+    n->release_ref();
+    n = tmp;
+  }
+  return(n);
+}
+
+/* get the name of the variable referenced by a ci element */
+static std::wstring ciName(iface::dom::Node* ci)
+{
+  std::wstring name;
+  RETURN_INTO_OBJREF(n,iface::dom::Node,ci->firstChild());
+  while (n)
+  {
+    if (n->nodeType() == iface::dom::Node::TEXT_NODE)
+    {
+      RETURN_INTO_WSTRING(text,n->nodeValue());
+      name += text;
+    }
+    n = already_AddRefd<iface::dom::Node>(n->nextSibling());
+  }
+  const wchar_t* ws = L" \t\r\n";
+  size_t first = name.find_first_not_of(ws);
+  if (first == std::wstring::npos) return L"";
+  size_t last = name.find_last_not_of(ws);
+  return name.substr(first,last-first+1);
+}
+
+/* append the source variable of the named variable in the given component to
+   the list, if it is not already in the list */
+static void addSourceVariable(iface::cellml_api::CellMLComponent* c,
+  const std::wstring& name,VariableList& list,
+  std::set<iface::cellml_api::CellMLVariable*>& seen)
+{
+  RETURN_INTO_OBJREF(vs,iface::cellml_api::CellMLVariableSet,c->variables());
+  RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+    vs->getVariable(name.c_str()));
+  if (v == NULL)
+  {
+    RETURN_INTO_WSTRING(cname,c->name());
+    std::cerr << "Unable to find the variable " << narrow(name)
+              << " used in a derivative in component " << narrow(cname)
+              << std::endl;
+    return;
+  }
+  RETURN_INTO_OBJREF(sv,iface::cellml_api::CellMLVariable,
+    v->sourceVariable());
+  if (sv == NULL) sv = v;
+  if (seen.insert(sv).second) list.push_back(sv);
+}
+
+/* look for derivatives within the given MathML node and its descendants */
+static void scanMath(iface::cellml_api::CellMLComponent* c,
+  iface::dom::Node* node,
+  VariableList& stateVariables,VariableList& boundVariables,
+  std::set<iface::cellml_api::CellMLVariable*>& seenState,
+  std::set<iface::cellml_api::CellMLVariable*>& seenBound)
+{
+  if (isMathMLElement(node,L"apply"))
+  {
+    RETURN_INTO_OBJREF(op,iface::dom::Node,nextElement(node,false));
+    if (op && isMathMLElement(op,L"diff"))
+    {
+      /* <apply><diff/><bvar><ci>t</ci></bvar><ci>x</ci></apply> */
+      RETURN_INTO_OBJREF(arg,iface::dom::Node,nextElement(op,true));
+      while (arg)
+      {
+        if (isMathMLElement(arg,L"bvar"))
+        {
+          RETURN_INTO_OBJREF(bv,iface::dom::Node,nextElement(arg,false));
+          while (bv && !isMathMLElement(bv,L"ci"))
+            bv = already_AddRefd<iface::dom::Node>(nextElement(bv,true));
+          if (bv) addSourceVariable(c,ciName(bv),boundVariables,seenBound);
+        }
+        else if (isMathMLElement(arg,L"ci"))
+          addSourceVariable(c,ciName(arg),stateVariables,seenState);
+        arg = already_AddRefd<iface::dom::Node>(nextElement(arg,true));
+      }
+    }
+  }
+  RETURN_INTO_OBJREF(child,iface::dom::Node,nextElement(node,false));
+  while (child)
+  {
+    scanMath(c,child,stateVariables,boundVariables,seenState,seenBound);
+    child = already_AddRefd<iface::dom::Node>(nextElement(child,true));
+  }
+}
+
+void findVariableReferences(iface::dom::Node* node,
+  std::set<std::wstring>& names)
+{
+  if (isMathMLElement(node,L"ci"))
+  {
+    names.insert(ciName(node));
+    return;
+  }
+  RETURN_INTO_OBJREF(child,iface::dom::Node,nextElement(node,false));
+  while (child)
+  {
+    findVariableReferences(child,names);
+    child = already_AddRefd<iface::dom::Node>(nextElement(child,true));
+  }
+}
+
+std::wstring definedVariable(iface::dom::Node* equation)
+{
+  if (!isMathMLElement(equation,L"apply")) return L"";
+  /* <apply><eq/><ci>x</ci> ... </apply> */
+  RETURN_INTO_OBJREF(op,iface::dom::Node,nextElement(equation,false));
+  if (!op || !isMathMLElement(op,L"eq")) return L"";
+  RETURN_INTO_OBJREF(lhs,iface::dom::Node,nextElement(op,true));
+  if (!lhs || !isMathMLElement(lhs,L"ci")) return L"";
+  return ciName(lhs);
+}
+
+void classifyVariablesMathML(iface::cellml_services::CeVAS* cevas,
+  VariableList& stateVariables,VariableList& boundVariables)
+{
+  std::set<iface::cellml_api::CellMLVariable*> seenState, seenBound;
+  RETURN_INTO_OBJREF(ci,iface::cellml_api::CellMLComponentIterator,
+    cevas->iterateRelevantComponents());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(c,iface::cellml_api::CellMLComponent,
+      ci->nextComponent());
+    if (c == NULL) break;
+    RETURN_INTO_OBJREF(math,iface::cellml_api::MathList,c->math());
+    RETURN_INTO_OBJREF(mathIt,iface::cellml_api::MathMLElementIterator,
+      math->iterate());
+    while (true)
+    {
+      RETURN_INTO_OBJREF(m,iface::mathml_dom::MathMLElement,mathIt->next());
+      if (m == NULL) break;
+      scanMath(c,m,stateVariables,boundVariables,seenState,seenBound);
+    }
+  }
+}
+
+bool classifyVariablesCCGS(iface::cellml_api::Model* model,
+  iface::cellml_services::CeVAS* cevas,
+  iface::cellml_services::CodeGeneratorBootstrap* cgb,
+  VariableList& stateVariables,VariableList& boundVariables)
+{
+  RETURN_INTO_OBJREF(cg,iface::cellml_services::CodeGenerator,
+    cgb->createCodeGenerator());
+  cg->useCeVAS(cevas);
+  try
+  {
+    ObjRef<iface::cellml_services::CodeInformation> cci;
+    {
+      ProfileScope profile("generateCode");
+      cci = already_AddRefd<iface::cellml_services::CodeInformation>(
+        cg->generateCode(model));
+    }
+    RETURN_INTO_OBJREF(cti,iface::cellml_services::ComputationTargetIterator,
+      cci->iterateTargets());
+    while(true)
+    {
+      RETURN_INTO_OBJREF(ct,iface::cellml_services::ComputationTarget,
+        cti->nextComputationTarget());
+      if (ct == NULL) break;
+      if (ct->type() == iface::cellml_services::STATE_VARIABLE)
+      {
+        RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,ct->variable());
+        stateVariables.push_back(std::move(v));
+      }
+      if (ct->type() == iface::cellml_services::VARIABLE_OF_INTEGRATION)
+      {
+        RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,ct->variable());
+        boundVariables.push_back(std::move(v));
+      }
+    }
+  }
+  catch (iface::cellml_api::CellMLException& ce)
+  {
+    printf("Caught a CellMLException while generating code.\n");
+    return false;
+  }
+  catch (...)
+  {
+    printf("Unexpected exception calling generateCode!\n");
+    return false;
+  }
+  return true;
+}
+
+/* report any variables in the first list which are not in the second */
+static int reportMissing(const VariableList& a,const VariableList& b,
+  const char* what,const char* missingFrom)
+{
+  std::set<iface::cellml_api::CellMLVariable*> inB;
+  VariableList::const_iterator i = b.begin();
+  for (;i!=b.end();++i) inB.insert(*i);
+  int n = 0;
+  for (i=a.begin();i!=a.end();++i)
+  {
+    if (inB.find(*i) != inB.end()) continue;
+    RETURN_INTO_WSTRING(name,(*i)->name());
+    RETURN_INTO_WSTRING(cname,(*i)->componentName());
+    std::cerr << "Classifier mismatch: " << what << " " << narrow(cname)
+              << "/" << narrow(name) << " not found by the " << missingFrom
+              << std::endl;
+    n++;
+  }
+  return n;
+}
+
+bool classifyVariables(ClassifierMode mode,iface::cellml_api::Model* model,
+  iface::cellml_services::CeVAS* cevas,
+  iface::cellml_services::CodeGeneratorBootstrap* cgb,
+  VariableList& stateVariables,VariableList& boundVariables)
+{
+  if (mode == CLASSIFY_MATHML)
+  {
+    classifyVariablesMathML(cevas,stateVariables,boundVariables);
+    return true;
+  }
+  if (!classifyVariablesCCGS(model,cevas,cgb,stateVariables,boundVariables))
+    return false;
+  if (mode == CLASSIFY_CHECK)
+  {
+    VariableList mathState, mathBound;
+    classifyVariablesMathML(cevas,mathState,mathBound);
+    int n = 0;
+    n += reportMissing(stateVariables,mathState,"state variable",
+      "MathML classifier");
+    n += reportMissing(mathState,stateVariables,"state variable","CCGS");
+    n += reportMissing(boundVariables,mathBound,"bound variable",
+      "MathML classifier");
+    n += reportMissing(mathBound,boundVariables,"bound variable","CCGS");
+    if (n == 0)
+      std::cout << "Classifier check: MathML and CCGS classifications agree"
+                << std::endl;
+  }
+  return true;
+}
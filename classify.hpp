@@ -0,0 +1,77 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _CLASSIFY_HPP_
+#define _CLASSIFY_HPP_
+
+#include <string>
+#include <set>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCCGS.hxx>
+
+#include "decompose.hpp"
+
+/* Find the state variables and variables of integration in the relevant
+   components of a model by looking for derivatives in each component's
+   math. The source variables of any differentiated and bound variables are
+   appended to the given lists. */
+void classifyVariablesMathML(iface::cellml_services::CeVAS* cevas,
+  VariableList& stateVariables,VariableList& boundVariables);
+
+/* Find the state variables and variables of integration by generating code
+   for the model with the CCGS. Returns false if code generation fails. */
+bool classifyVariablesCCGS(iface::cellml_api::Model* model,
+  iface::cellml_services::CeVAS* cevas,
+  iface::cellml_services::CodeGeneratorBootstrap* cgb,
+  VariableList& stateVariables,VariableList& boundVariables);
+
+/* Add the names of the variables referenced by the ci elements in the given
+   MathML node and its descendants to the set */
+void findVariableReferences(iface::dom::Node* node,
+  std::set<std::wstring>& names);
+
+/* The name of the variable defined by the given MathML equation if it is of
+   the form <ci>x</ci> = ..., otherwise an empty string */
+std::wstring definedVariable(iface::dom::Node* equation);
+
+/* Find the state variables and variables of integration using the given
+   classifier mode, returning false if the classification fails */
+bool classifyVariables(ClassifierMode mode,iface::cellml_api::Model* model,
+  iface::cellml_services::CeVAS* cevas,
+  iface::cellml_services::CodeGeneratorBootstrap* cgb,
+  VariableList& stateVariables,VariableList& boundVariables);
+
+#endif /* _CLASSIFY_HPP_ */
@@ -0,0 +1,79 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <utility>
+
+#include "connections.hpp"
+#include "profile.hpp"
+
+ConnectionGraph::ConnectionGraph(Arena& arena) :
+  mArena(arena), mIndex(0,std::hash<uint64_t>(),std::equal_to<uint64_t>(),
+    arena),
+  mMappings(0,MappingKeyHash(),std::equal_to<MappingKey>(),arena),
+  mConnections(arena), mMappingCount(0)
+{
+}
+
+void ConnectionGraph::store(NameId component_1,NameId variable_1,
+  NameId component_2,NameId variable_2)
+{
+  profileCount(PROFILE_STORE_CONNECTION);
+  /* the key is the pair of component IDs in sorted order */
+  uint64_t key = (component_2 < component_1) ?
+    nameIdKey(component_2,component_1) : nameIdKey(component_1,component_2);
+  IndexMap::const_iterator i = mIndex.find(key);
+  if (i == mIndex.end())
+  {
+    /* existing connection between components not found so make a new one */
+    ConnectionDescription& con = mConnections.emplace_back(
+      NameIdPair(component_1,component_2),mArena);
+    con.variables.push_back(NameIdPair(variable_1,variable_2));
+    mIndex[key] = &con;
+    mMappings.insert(MappingKey(&con,variable_1,variable_2));
+    mMappingCount++;
+    return;
+  }
+  /* orient the variables the same way as the existing connection */
+  ConnectionDescription& con = *(i->second);
+  NameIdPair variables = (con.components.first == component_1) ?
+    NameIdPair(variable_1,variable_2) : NameIdPair(variable_2,variable_1);
+  if (mMappings.insert(
+      MappingKey(&con,variables.first,variables.second)).second)
+  {
+    /* connection between these two variables not found so add it */
+    con.variables.push_back(variables);
+    mMappingCount++;
+  }
+}
@@ -0,0 +1,131 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _CONNECTIONS_HPP_
+#define _CONNECTIONS_HPP_
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <inttypes.h>
+
+#include "names.hpp"
+#include "arena.hpp"
+
+/* A connection between two components, with the variables mapped by it,
+   as IDs in the decomposition's NamePool */
+typedef ArenaList<NameIdPair> MappingList;
+class ConnectionDescription
+{
+public:
+  ConnectionDescription(const NameIdPair& c,Arena& arena) : components(c),
+    variables(arena)
+  {
+  }
+  NameIdPair components;
+  MappingList variables;
+};
+typedef ArenaList<ConnectionDescription> ConnectionList;
+
+/* The set of connections between components, keyed on the (unordered) pair
+   of component name IDs with a hashed set of the variable pairs mapped in
+   each connection. The connections and variable mappings are kept in the
+   order they were first stored so that the generated models are stable.
+   Everything apart from the hash tables' bucket arrays is allocated from
+   the given arena. */
+class ConnectionGraph
+{
+public:
+  ConnectionGraph(Arena& arena);
+  /* store the connection between the two variables, if it isn't already
+     stored */
+  void store(NameId component_1,NameId variable_1,NameId component_2,
+    NameId variable_2);
+  /* the connections, in the order they were first stored */
+  const ConnectionList& connections() const
+  {
+    return mConnections;
+  }
+  size_t connectionCount() const
+  {
+    return mConnections.size();
+  }
+  size_t mappingCount() const
+  {
+    return mMappingCount;
+  }
+private:
+  /* a variable pair mapped in a connection */
+  class MappingKey
+  {
+  public:
+    MappingKey(const ConnectionDescription* c,NameId v1,NameId v2) :
+      connection(c), variables(nameIdKey(v1,v2))
+    {
+    }
+    bool operator==(const MappingKey& other) const
+    {
+      return ((connection == other.connection) &&
+        (variables == other.variables));
+    }
+    const ConnectionDescription* connection;
+    uint64_t variables;
+  };
+  class MappingKeyHash
+  {
+  public:
+    size_t operator()(const MappingKey& key) const
+    {
+      return std::hash<uint64_t>()(key.variables) ^
+        std::hash<const void*>()(key.connection);
+    }
+  };
+  typedef std::unordered_set<MappingKey,MappingKeyHash,
+                             std::equal_to<MappingKey>,
+                             ArenaAllocator<MappingKey> > MappingSet;
+  typedef std::unordered_map<uint64_t,ConnectionDescription*,
+                             std::hash<uint64_t>,std::equal_to<uint64_t>,
+                             ArenaAllocator<std::pair<const uint64_t,
+                               ConnectionDescription*> > > IndexMap;
+  Arena& mArena;
+  // map from the ordered pair of component IDs to the connection
+  IndexMap mIndex;
+  // the variable pairs already mapped in all the connections
+  MappingSet mMappings;
+  ConnectionList mConnections;
+  size_t mMappingCount;
+};
+
+#endif /* _CONNECTIONS_HPP_ */
@@ -0,0 +1,96 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _DECOMPOSE_HPP_
+#define _DECOMPOSE_HPP_
+
+#include <string>
+#include <vector>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+
+typedef std::vector< ObjRef<iface::cellml_api::CellMLVariable> > VariableList;
+
+/* The ways we can find the state variables and variables of integration */
+enum ClassifierMode
+{
+  // scan the MathML for derivatives
+  CLASSIFY_MATHML,
+  // use the variables found when generating code with the CCGS
+  CLASSIFY_CCGS,
+  // use the CCGS but report any differences to the MathML scan
+  CLASSIFY_CHECK
+};
+
+class AnalysisCache;
+
+/* Options controlling how models are decomposed */
+class DecomposeOptions
+{
+public:
+  DecomposeOptions() : jobs(1), classifier(CLASSIFY_MATHML), archive(false),
+    stream(false), incremental(false), cache(NULL), memoryReport(false),
+    memoryBudget(0), keepEncapsulation(false), prune(false)
+  {
+  }
+  // the number of threads to use building component models, zero for all
+  // available hardware threads
+  int jobs;
+  ClassifierMode classifier;
+  // write each model's documents into a single archive rather than a file
+  // per document
+  bool archive;
+  // write each component model as soon as it is built and let go of it
+  bool stream;
+  // only rebuild and rewrite the documents which have changed since the
+  // last run into the same output directory
+  bool incremental;
+  // the cache of model analysis results to use, if any
+  AnalysisCache* cache;
+  // report the memory used by each phase
+  bool memoryReport;
+  // the memory we may use, in kilobytes, zero for no limit
+  long memoryBudget;
+  // rebuild the source encapsulation hierarchy under the interface
+  // component, rather than putting every component directly beneath it
+  bool keepEncapsulation;
+  // leave out the variables, equations and connections of the flattened
+  // components which the simulation of the model doesn't need
+  bool prune;
+};
+
+#endif /* _DECOMPOSE_HPP_ */
@@ -0,0 +1,1533 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <inttypes.h>
+#include <exception>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <libxml/parser.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCCGS.hxx>
+#include <CeVASBootstrap.hpp>
+#include <MaLaESBootstrap.hpp>
+#include <CCGSBootstrap.hpp>
+#include <CellMLBootstrap.hpp>
+
+#include "utils.hxx"
+#include "decompose.hpp"
+#include "classify.hpp"
+#include "roles.hpp"
+#include "usage.hpp"
+#include "connections.hpp"
+#include "names.hpp"
+#include "strings.hpp"
+#include "namespaces.hpp"
+#include "units.hpp"
+#include "output.hpp"
+#include "manifest.hpp"
+#include "cache.hpp"
+#include "profile.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "version.hpp"
+#include "decomposer.hpp"
+
+typedef std::vector< ObjRef<iface::cellml_api::Model> > ModelList;
+typedef std::vector< std::wstring > StringList;
+typedef std::vector< ObjRef<iface::dom::Node> > DOMNodeList;
+/* the updates a component's variables make to the shared interface, variable
+   values and connection state of the decomposed model */
+enum SharedUpdateType
+{
+  BOUND_VARIABLE,
+  CALCULATED_VARIABLE,
+  EXPOSED_VARIABLE,
+  INITIAL_VALUE_VARIABLE,
+  PARAMETER_VARIABLE
+};
+typedef std::pair<SharedUpdateType,const VariableInfo*> SharedUpdate;
+typedef std::vector<SharedUpdate> SharedUpdateList;
+
+/* where a new component goes in the interface model's encapsulation
+   hierarchy, which decides how its variables are connected */
+enum ComponentPlacement
+{
+  // directly under the interface component, with every variable the rest
+  // of the model needs connected through the interface
+  PLACE_FLAT,
+  // under the interface component as one of the source model's top-level
+  // components, keeping its source interfaces and connections
+  PLACE_TOP_LEVEL,
+  // under its source encapsulation parent, exactly as in the source model
+  PLACE_NESTED
+};
+
+/* a model and the name of the document it is to be written to */
+typedef std::pair<std::string,ObjRef<iface::cellml_api::Model> > NamedModel;
+typedef std::vector<NamedModel> NamedModelList;
+
+/* where the units model and the first component model come in the list of
+   documents making up the decomposed model */
+#define UNITS_DOCUMENT 1
+#define COMPONENT_DOCUMENTS 4
+
+/* for naming a model's output XML document */
+void nameModel(NamedModelList& list,iface::cellml_api::Model* model,
+  NameAllocator& files)
+{
+  std::wstring filename;
+  GET_SET_WSTRING(model->name(),filename);
+  list.push_back(NamedModel(narrow(files.allocate(filename) + L".xml"),
+    model));
+}
+
+void addElement(iface::cellml_api::CellMLElement* parent,
+  iface::cellml_api::CellMLElement* child)
+{
+  try
+  {
+    parent->addElement(child);
+  }
+  catch (iface::cellml_api::CellMLException& ce)
+  {
+    std::cerr << "Caught a CellMLException while trying to add an element"
+              << std::endl;
+  }
+  catch (...)
+  {
+    // no need for this?
+    std::cerr << "Unexpected error caught adding an element"
+              << std::endl;
+  }
+}
+
+class DecomposedModel
+{
+public:
+  DecomposedModel(iface::cellml_api::CellMLBootstrap* cb,
+    std::wstring& baseName,const VariableRoleIndex& index,NamePool& names,
+    Arena& arena,bool keepEncapsulation) :
+    mArena(arena),
+    mCB(cb),
+    mBCs(mCB->createModel(L"1.1")),
+    mUnits(mCB->createModel(L"1.1")),
+    mInterface(mCB->createModel(L"1.1")),
+    mExperiment(mCB->createModel(L"1.1")),
+    mExperimentParameters(arena),
+    mExperimentInitialValues(arena),
+    mIndex(index),
+    mNames(names),
+    mInterfaceConnections(mArena),
+    mKeepEncapsulation(keepEncapsulation)
+  {
+    /*
+     * create a model for storing all the boundary and initial conditions
+     */
+    std::wstring name = baseName + L"_variable_values_model";
+    mBCs->name(name.c_str());
+    // create a parameter component for BCs
+    iface::cellml_api::CellMLComponent* c = mBCs->createComponent();
+    name = L"parameters";
+    c->name(name.c_str());
+    addElement(mBCs,c);
+    mParameters = c;
+    // and a initial_value component for all the differential equations
+    c = mBCs->createComponent();
+    name = L"initial_values";
+    c->name(name.c_str());
+    addElement(mBCs,c);
+    mInitialValues = c;
+    /*
+     * create a model for storing all the units defined in the model
+     */
+    name = baseName + L"_units_model";
+    mUnits->name(name.c_str());
+    mUnitsFile = name + L".xml";
+    /*
+     * create a model in which we will define the interface to the entire
+     * decomposed model
+     */
+    name = baseName + L"_interface_model";
+    mInterface->name(name.c_str());
+    c = mInterface->createComponent();
+    mInterfaceComponentName = baseName + L"_interface_component";
+    c->name(mInterfaceComponentName.c_str());
+    addElement(mInterface,c);
+    mInterfaceComponent = c;
+    mInterfaceComponentId = mNames.intern(mInterfaceComponentName);
+    // create an encapsulation hierarchy
+    RETURN_INTO_OBJREF(g,iface::cellml_api::Group,mInterface->createGroup());
+    addElement(mInterface,g);
+    RETURN_INTO_OBJREF(rr,iface::cellml_api::RelationshipRef,
+      mInterface->createRelationshipRef());
+    rr->setRelationshipName(L"",L"encapsulation");
+    addElement(g,rr);
+    RETURN_INTO_OBJREF(ref,iface::cellml_api::ComponentRef,
+      mInterface->createComponentRef());
+    ref->componentName(mInterfaceComponentName.c_str());
+    addElement(g,ref);
+    mEncapsInterface = ref;
+    if (mKeepEncapsulation) findEncapsulationParents();
+    /*
+     * create a model in which we will create an example experiment using the
+     * decomposed model - this should reflect the original 1.0 model
+     */
+    name = baseName + L"_experiment_model";
+    mExperiment->name(name.c_str());
+    // add the import for the parameters and initial conditions
+    RETURN_INTO_OBJREF(impBCs,iface::cellml_api::CellMLImport,
+      mExperiment->createCellMLImport());
+    RETURN_INTO_OBJREF(uri,iface::cellml_api::URI,impBCs->xlinkHref());
+    std::wstring u = baseName + L"_variable_values_model.xml";
+    uri->asText(u.c_str());
+    addElement(mExperiment,impBCs);
+    RETURN_INTO_OBJREF(impParametersC,iface::cellml_api::ImportComponent,
+      mExperiment->createImportComponent());
+    impParametersC->name(L"parameters");
+    impParametersC->componentRef(L"parameters");
+    addElement(impBCs,impParametersC);
+    RETURN_INTO_OBJREF(impIVC,iface::cellml_api::ImportComponent,
+      mExperiment->createImportComponent());
+    impIVC->name(L"initial_values");
+    impIVC->componentRef(L"initial_values");
+    addElement(impBCs,impIVC);
+    // and the import for the model interface
+    RETURN_INTO_OBJREF(impInterface,iface::cellml_api::CellMLImport,
+      mExperiment->createCellMLImport());
+    RETURN_INTO_OBJREF(uri2,iface::cellml_api::URI,impInterface->xlinkHref());
+    u = baseName + L"_interface_model.xml";
+    uri2->asText(u.c_str());
+    addElement(mExperiment,impInterface);
+    RETURN_INTO_OBJREF(impInterfaceC,iface::cellml_api::ImportComponent,
+      mExperiment->createImportComponent());
+    impInterfaceC->name(mInterfaceComponentName.c_str());
+    impInterfaceC->componentRef(mInterfaceComponentName.c_str());
+    addElement(impInterface,impInterfaceC);
+  }
+  ~DecomposedModel()
+  {
+    /* nothing to do? */
+  }
+  /* name the documents for all the models making up the decomposed model,
+     returning the names in the order they will be written out */
+  std::vector<std::string> nameDocuments()
+  {
+    nameModel(mDocuments,mBCs,mFileNames);
+    nameModel(mDocuments,mUnits,mFileNames);
+    nameModel(mDocuments,mInterface,mFileNames);
+    nameModel(mDocuments,mExperiment,mFileNames);
+    ModelList::const_iterator i = mModels.begin();
+    for (;i!=mModels.end();++i)
+    {
+      nameModel(mDocuments,*i,mFileNames);
+    }
+    mEmitted.assign(mDocuments.size(),false);
+    std::vector<std::string> names;
+    NamedModelList::const_iterator m = mDocuments.begin();
+    for (;m!=mDocuments.end();++m) names.push_back(m->first);
+    return names;
+  }
+  /* the name of the document for the i'th component model */
+  const std::string& componentDocument(size_t i) const
+  {
+    return mDocuments[COMPONENT_DOCUMENTS+i].first;
+  }
+  /* pass the finished units model straight on to the output */
+  void emitUnits(OutputPipeline& output)
+  {
+    emit(output,UNITS_DOCUMENT);
+  }
+  /* pass the finished i'th component model straight on to the output and
+     let go of it */
+  void emitComponent(OutputPipeline& output,size_t i)
+  {
+    mModels[i] = NULL;
+    emit(output,COMPONENT_DOCUMENTS+i);
+  }
+  /* dump out the rest of the decomposed model */
+  bool dump(OutputPipeline& output)
+  {
+    for (size_t d=0;d<mDocuments.size();++d) emit(output,d);
+    return output.finish();
+  }
+  /* the number of models making up the decomposed model which it still
+     holds, leaving out the component models already streamed out */
+  size_t modelCount() const
+  {
+    size_t count = 4;
+    ModelList::const_iterator i = mModels.begin();
+    for (;i!=mModels.end();++i)
+    {
+      if (*i) count++;
+    }
+    return count;
+  }
+  /* keep the named document from a previous run rather than writing it */
+  void keep(const std::string& document)
+  {
+    mKept.insert(document);
+  }
+  /* Create a new model for the given source component and add a clone of the
+   * component to it
+   */
+  iface::cellml_api::CellMLComponent*
+  addComponent(iface::cellml_api::CellMLComponent* src)
+  {
+    /* FIXME: we're assuming all component names are unique, which should be
+              safe since we should be decomposing CellML 1.0 models...
+    */
+    // make the new model document
+    RETURN_INTO_OBJREF(model,iface::cellml_api::Model,
+      mCB->createModel(L"1.1"));
+    RETURN_INTO_WSTRING(cname,src->name());
+    std::wstring name = cname + L"_model";
+    model->name(name.c_str());
+    // and add it to the list of generated models
+    mModels.push_back(model);
+    // then create a component in the new model
+    /****
+      This don't work cause the parent model doesn't match the new model. But
+      really need to iterate over the contents of the component in order to
+      work out what units are required and sorting out the variables and
+      stuff. Just need to find an easy way to copy over the math...
+    RETURN_INTO_OBJREF(clone,iface::cellml_api::CellMLElement,
+    src->clone(___deep___ true));
+    addElement(model,clone);
+    */
+    iface::cellml_api::CellMLComponent* c = model->createComponent();
+    c->name(cname.c_str());
+    addElement(model,c);
+    // and make an import for it in the interface component
+    RETURN_INTO_OBJREF(imp,iface::cellml_api::CellMLImport,
+      mInterface->createCellMLImport());
+    RETURN_INTO_OBJREF(uri,iface::cellml_api::URI,imp->xlinkHref());
+    // FIXME: assume files all in one directory and names unique
+    std::wstring u = name + L".xml";
+    uri->asText(u.c_str());
+    addElement(mInterface,imp);
+    // and add the component import statement
+    RETURN_INTO_OBJREF(impC,iface::cellml_api::ImportComponent,
+      mInterface->createImportComponent());
+    impC->name(cname.c_str());
+    impC->componentRef(cname.c_str());
+    addElement(imp,impC);
+    // and add the imported component to the encapsulation hierarchy
+    componentRef(mNames.intern(cname));
+    return(c);
+  }
+  /* where the new component for the given source component goes */
+  ComponentPlacement placement(iface::cellml_api::CellMLComponent* src)
+  {
+    if (!mKeepEncapsulation) return PLACE_FLAT;
+    RETURN_INTO_WSTRING(name,src->name());
+    if (encapsulationParent(mNames.intern(name)) == mInterfaceComponentId)
+      return PLACE_TOP_LEVEL;
+    return PLACE_NESTED;
+  }
+  void makeInterfaceConnections(const VariableInfo& src)
+  {
+    // connect to all the connected variables
+    VariableIdList::const_iterator i = src.connected.begin();
+    for (;i!=src.connected.end();++i)
+    {
+      if (pruned(*i)) continue;
+      mInterfaceConnections.store(mInterfaceComponentId,
+        src.nameId,i->first,i->second);
+    }
+  }
+  void makeInterfaceConnectionsIV(const VariableInfo& src)
+  {
+    NameId srcName = src.nameId;
+    NameId srcCName = src.componentId;
+    NameId srcNameIV = mNames.initialValueName(srcName);
+    if (mKeepEncapsulation)
+    {
+      /* the state variable itself keeps its source connections, so only
+         the initial value comes from the interface */
+      mInterfaceConnections.store(mInterfaceComponentId,srcNameIV,
+        srcCName,srcNameIV);
+      return;
+    }
+    /* store the connection to the source variable from the interface */
+    mInterfaceConnections.store(mInterfaceComponentId,srcName,
+      srcCName,srcName);
+    /* and the initial value connection */
+    mInterfaceConnections.store(mInterfaceComponentId,srcNameIV,
+      srcCName,srcNameIV);
+    /* and then all other connections between components? */
+    // grab all the connected variables
+    VariableIdList::const_iterator i = src.connected.begin();
+    for (;i!=src.connected.end();++i)
+    {
+      if (((i->first != srcCName) || (i->second != srcName)) && !pruned(*i))
+        mInterfaceConnections.store(srcCName,srcName,i->first,i->second);
+    }
+  }
+  void addParameterVariable(const VariableInfo& src)
+  {
+    const wchar_t* name = mNames.name(src.nameId);
+    const wchar_t* units = mNames.name(src.unitsId);
+    /* add the variable to the parameters component in the BCs model */
+    RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+      mBCs->createCellMLVariable());
+    v->name(name);
+    v->initialValue(mNames.name(src.initialValueId));
+    v->unitsName(units);
+    v->publicInterface(iface::cellml_api::INTERFACE_OUT);
+    v->privateInterface(iface::cellml_api::INTERFACE_OUT);
+    addElement(mParameters,v);
+    /* add the variable to the interface component in the interface model */
+    /* FIXME: this assumes model parameters are always uniquely named */
+    RETURN_INTO_OBJREF(vInt,iface::cellml_api::CellMLVariable,
+      mInterface->createCellMLVariable());
+    vInt->name(name);
+    vInt->unitsName(units);
+    vInt->publicInterface(iface::cellml_api::INTERFACE_IN);
+    vInt->privateInterface(iface::cellml_api::INTERFACE_OUT);
+    addElement(mInterfaceComponent,vInt);
+    /* and create any connections to anywhere the parameter is used */
+    if (mKeepEncapsulation)
+    {
+      /* the parameter's source connections to other top-level components
+         are moved over to the interface variable in addSourceConnections,
+         those to its child components stay where they are */
+      mInterfaceConnections.store(mInterfaceComponentId,src.nameId,
+        src.componentId,src.nameId);
+      mExtractedParameters.insert(nameIdKey(src.componentId,src.nameId));
+    }
+    else makeInterfaceConnections(src);
+    /* add add the variable to the list of variables that will be connected
+       in the example experiment */
+    mExperimentParameters.push_back(NameIdPair(src.nameId,src.nameId));
+  }
+  void addInitialValueVariable(const VariableInfo& src)
+  {
+    NameId nameId = mNames.initialValueName(src.nameId);
+    const wchar_t* name = mNames.name(nameId);
+    const wchar_t* units = mNames.name(src.unitsId);
+    /* add the variable to the initial_value component in the BCs model */
+    RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+      mBCs->createCellMLVariable());
+    v->name(name);
+    v->initialValue(mNames.name(src.initialValueId));
+    v->unitsName(units);
+    v->publicInterface(iface::cellml_api::INTERFACE_OUT);
+    v->privateInterface(iface::cellml_api::INTERFACE_OUT);
+    addElement(mInitialValues,v);
+    /* add the variable to the interface component in the interface model */
+    RETURN_INTO_OBJREF(vInt,iface::cellml_api::CellMLVariable,
+      mInterface->createCellMLVariable());
+    vInt->name(name);
+    vInt->unitsName(units);
+    vInt->publicInterface(iface::cellml_api::INTERFACE_IN);
+    vInt->privateInterface(iface::cellml_api::INTERFACE_OUT);
+    addElement(mInterfaceComponent,vInt);
+    /* and create any connections to anywhere the variable is used */
+    makeInterfaceConnectionsIV(src);
+    /* add add the variable to the list of variables that will be connected
+       in the example experiment */
+    mExperimentInitialValues.push_back(NameIdPair(nameId,nameId));
+  }
+  /* make the given variable available from the interface component */
+  void addExposedVariable(const VariableInfo& src)
+  {
+    /* FIXME: assuming the same variable is never going to be added more than
+       once, probably ok since the source model should be valid...
+    */
+    std::wstring localName =
+      mInterfaceNames.allocate(mNames.name(src.nameId));
+    /* add the variable to the interface component in the interface model */
+    RETURN_INTO_OBJREF(vInt,iface::cellml_api::CellMLVariable,
+      mInterface->createCellMLVariable());
+    vInt->name(localName.c_str());
+    vInt->unitsName(mNames.name(src.unitsId));
+    vInt->publicInterface(iface::cellml_api::INTERFACE_OUT);
+    vInt->privateInterface(iface::cellml_api::INTERFACE_IN);
+    addElement(mInterfaceComponent,vInt);
+    /* store the connection to the source variable from the interface */
+    mInterfaceConnections.store(mInterfaceComponentId,
+      mNames.intern(localName),src.componentId,src.nameId);
+  }
+  void addCalculatedVariable(const VariableInfo& src)
+  {
+    NameId name = src.nameId;
+    NameId srcCName = src.componentId;
+    addExposedVariable(src);
+    /* and add the connections to other components */
+    // grab all the connected variables
+    VariableIdList::const_iterator i = src.connected.begin();
+    for (;i!=src.connected.end();++i)
+    {
+      if (((i->first != srcCName) || (i->second != name)) && !pruned(*i))
+        mInterfaceConnections.store(srcCName,name,i->first,i->second);
+    }
+  }
+  void addBoundVariable(const VariableInfo& src)
+  {
+    /* we only want to add the source bound variable, not all the occurances */
+    const VariableInfo& sv = *(src.sourceInfo);
+    if (&src == &sv)
+    {
+      /* add the source variable to the interface component in the interface
+         model */
+      RETURN_INTO_OBJREF(vInt,iface::cellml_api::CellMLVariable,
+        mInterface->createCellMLVariable());
+      vInt->name(mNames.name(sv.nameId));
+      vInt->unitsName(mNames.name(sv.unitsId));
+      vInt->publicInterface(iface::cellml_api::INTERFACE_NONE);
+      vInt->privateInterface(iface::cellml_api::INTERFACE_OUT);
+      addElement(mInterfaceComponent,vInt);
+    }
+    /* store the connection to the source variable from the interface */
+    mInterfaceConnections.store(mInterfaceComponentId,sv.nameId,
+      src.componentId,src.nameId);
+  }
+  /* leave the given variables, which have been left out of their
+     components, out of all the connections */
+  void prune(const VariableInfoList& variables)
+  {
+    VariableInfoList::const_iterator i = variables.begin();
+    for (;i!=variables.end();++i)
+      mPruned.insert(nameIdKey((*i)->componentId,(*i)->nameId));
+  }
+  size_t prunedCount() const
+  {
+    return mPruned.size();
+  }
+  size_t connectionCount() const
+  {
+    return mInterfaceConnections.connectionCount();
+  }
+  size_t mappingCount() const
+  {
+    return mInterfaceConnections.mappingCount();
+  }
+  /* the model-scope units definitions, for working out the units
+     imports */
+  const UnitsDependencies& unitsDependencies() const
+  {
+    return mUnitsDependencies;
+  }
+  /* apply the shared updates required by a component's variables */
+  void applySharedUpdates(const SharedUpdateList& updates)
+  {
+    SharedUpdateList::const_iterator i = updates.begin();
+    for (;i!=updates.end();++i)
+    {
+      switch (i->first)
+      {
+      case BOUND_VARIABLE:
+        addBoundVariable(*(i->second));
+        break;
+      case CALCULATED_VARIABLE:
+        addCalculatedVariable(*(i->second));
+        break;
+      case EXPOSED_VARIABLE:
+        addExposedVariable(*(i->second));
+        break;
+      case INITIAL_VALUE_VARIABLE:
+        addInitialValueVariable(*(i->second));
+        break;
+      case PARAMETER_VARIABLE:
+        addParameterVariable(*(i->second));
+        break;
+      }
+    }
+  }
+  void createConnection(iface::cellml_api::Model* model,
+    const NameIdPair& components,const MappingList& variables)
+  {
+    RETURN_INTO_OBJREF(con,iface::cellml_api::Connection,
+      model->createConnection());
+    addElement(model,con);
+    RETURN_INTO_OBJREF(mc,iface::cellml_api::MapComponents,
+      con->componentMapping());
+    mc->firstComponentName(mNames.name(components.first));
+    mc->secondComponentName(mNames.name(components.second));
+    MappingList::const_iterator i = variables.begin();
+    for (;i!=variables.end();++i)
+    {
+      RETURN_INTO_OBJREF(mv,iface::cellml_api::MapVariables,
+        model->createMapVariables());
+      mv->firstVariableName(mNames.name(i->first));
+      mv->secondVariableName(mNames.name(i->second));
+      addElement(con,mv);
+    }
+  }
+  /* when keeping the encapsulation hierarchy, copy the source model's own
+     connections between the relevant components, which are still valid
+     since the hierarchy is the same. Connections from a top-level
+     parameter to another top-level component are made from the interface
+     component instead, as the parameter is now an input. */
+  void addSourceConnections(iface::cellml_api::Model* source)
+  {
+    RETURN_INTO_OBJREF(connections,iface::cellml_api::ConnectionSet,
+      source->connections());
+    RETURN_INTO_OBJREF(ci,iface::cellml_api::ConnectionIterator,
+      connections->iterateConnections());
+    while (true)
+    {
+      RETURN_INTO_OBJREF(con,iface::cellml_api::Connection,
+        ci->nextConnection());
+      if (con == NULL) break;
+      RETURN_INTO_OBJREF(mc,iface::cellml_api::MapComponents,
+        con->componentMapping());
+      RETURN_INTO_WSTRING(c1,mc->firstComponentName());
+      RETURN_INTO_WSTRING(c2,mc->secondComponentName());
+      NameId component_1 = mNames.intern(c1);
+      NameId component_2 = mNames.intern(c2);
+      if ((mEncapsulationParents.count(component_1) == 0) ||
+        (mEncapsulationParents.count(component_2) == 0))
+        continue;
+      bool topLevel =
+        (encapsulationParent(component_1) == mInterfaceComponentId) &&
+        (encapsulationParent(component_2) == mInterfaceComponentId);
+      RETURN_INTO_OBJREF(mvs,iface::cellml_api::MapVariablesSet,
+        con->variableMappings());
+      RETURN_INTO_OBJREF(mvi,iface::cellml_api::MapVariablesIterator,
+        mvs->iterateMapVariables());
+      while (true)
+      {
+        RETURN_INTO_OBJREF(mv,iface::cellml_api::MapVariables,
+          mvi->nextMapVariables());
+        if (mv == NULL) break;
+        RETURN_INTO_WSTRING(v1,mv->firstVariableName());
+        RETURN_INTO_WSTRING(v2,mv->secondVariableName());
+        NameId variable_1 = mNames.intern(v1);
+        NameId variable_2 = mNames.intern(v2);
+        NameId from_1 = component_1, from_2 = component_2;
+        if (topLevel &&
+          mExtractedParameters.count(nameIdKey(component_1,variable_1)))
+          from_1 = mInterfaceComponentId;
+        else if (topLevel &&
+          mExtractedParameters.count(nameIdKey(component_2,variable_2)))
+          from_2 = mInterfaceComponentId;
+        mInterfaceConnections.store(from_1,variable_1,from_2,variable_2);
+      }
+    }
+  }
+  void createConnections()
+  {
+    const ConnectionList& connections = mInterfaceConnections.connections();
+    ConnectionList::const_iterator i = connections.begin();
+    for (;i!=connections.end();++i)
+    {
+      createConnection(mInterface,i->components,i->variables);
+    }
+    /* and the connections for the example experiment model, first the
+       parameters and then the initial values */
+    createConnection(mExperiment,NameIdPair(mInterfaceComponentId,
+        mNames.intern(L"parameters")),mExperimentParameters);
+    createConnection(mExperiment,NameIdPair(mInterfaceComponentId,
+        mNames.intern(L"initial_values")),mExperimentInitialValues);
+  }
+  void addUnits(iface::cellml_api::Units* src)
+  {
+    DECLARE_QUERY_INTERFACE(srcCDE,src,cellml_api::CellMLDOMElement);
+    RETURN_INTO_OBJREF(srcElement,iface::dom::Element,srcCDE->domElement());
+    srcCDE->release_ref();
+    /* save the units name and what it is defined in terms of for the later
+       imports */
+    RETURN_INTO_WSTRING(name,src->name());
+    mUnitsDependencies.add(name,srcElement);
+    /* add a copy of the units element into the units model using straight
+       dom methods */
+    DECLARE_QUERY_INTERFACE(modelCDE,mUnits,cellml_api::CellMLDOMElement);
+    RETURN_INTO_OBJREF(modelElement,iface::dom::Element,
+      modelCDE->domElement());
+    modelCDE->release_ref();
+    RETURN_INTO_OBJREF(domDoc,iface::dom::Document,
+      modelElement->ownerDocument());
+    RETURN_INTO_OBJREF(importedNode,iface::dom::Node,
+      importNodeCellML11(domDoc,srcElement));
+    modelElement->appendChild(importedNode);
+  }
+  /* import the units the given model uses into it, along with the units
+     they are defined in terms of. This only touches the given model, so can
+     be used on several component models at once once all the units have
+     been added. */
+  void createUnitsImportsForModel(iface::cellml_api::Model* model) const
+  {
+    DECLARE_QUERY_INTERFACE(modelCDE,model,cellml_api::CellMLDOMElement);
+    RETURN_INTO_OBJREF(modelElement,iface::dom::Element,
+      modelCDE->domElement());
+    modelCDE->release_ref();
+    std::vector<std::wstring> names =
+      mUnitsDependencies.required(modelElement);
+    // models using only built-in units don't need the units model at all
+    if (names.empty()) return;
+    // create the model import to import the units model
+    RETURN_INTO_OBJREF(imp,iface::cellml_api::CellMLImport,
+      model->createCellMLImport());
+    RETURN_INTO_OBJREF(uri,iface::cellml_api::URI,imp->xlinkHref());
+    uri->asText(mUnitsFile.c_str());
+    addElement(model,imp);
+    // and then add a units import for each of the units needed
+    std::vector<std::wstring>::const_iterator i = names.begin();
+    for (;i!=names.end();++i)
+    {
+      RETURN_INTO_OBJREF(impU,iface::cellml_api::ImportUnits,
+        model->createImportUnits());
+      impU->name(i->c_str());
+      impU->unitsRef(i->c_str());
+      addElement(imp,impU);
+    }
+  }
+  void createUnitsImports()
+  {
+    /* add the units each model uses to it */
+    createUnitsImportsForModel(mInterface);
+    createUnitsImportsForModel(mBCs);
+    // (any component models already written out have their imports)
+    ModelList::const_iterator i = mModels.begin();
+    for (;i!=mModels.end();++i)
+    {
+      if (*i) createUnitsImportsForModel(*i);
+    }
+  }
+private:
+  /* find the nearest relevant encapsulation parent of each of the relevant
+     components, with the top-level ones under the interface component */
+  void findEncapsulationParents()
+  {
+    typedef std::vector< ObjRef<iface::cellml_api::CellMLComponent> >
+      ComponentList;
+    const ComponentList& components = mIndex.components();
+    std::unordered_set<NameId> relevant;
+    ComponentList::const_iterator i = components.begin();
+    for (;i!=components.end();++i)
+    {
+      RETURN_INTO_WSTRING(name,(*i)->name());
+      relevant.insert(mNames.intern(name));
+    }
+    for (i=components.begin();i!=components.end();++i)
+    {
+      RETURN_INTO_WSTRING(name,(*i)->name());
+      NameId parent = mInterfaceComponentId;
+      ObjRef<iface::cellml_api::CellMLComponent> p =
+        already_AddRefd<iface::cellml_api::CellMLComponent>(
+          (*i)->encapsulationParent());
+      while (p != NULL)
+      {
+        RETURN_INTO_WSTRING(pname,p->name());
+        NameId id = mNames.intern(pname);
+        if (relevant.count(id))
+        {
+          parent = id;
+          break;
+        }
+        p = already_AddRefd<iface::cellml_api::CellMLComponent>(
+          p->encapsulationParent());
+      }
+      mEncapsulationParents[mNames.intern(name)] = parent;
+    }
+  }
+  bool pruned(const VariableId& id) const
+  {
+    return (mPruned.count(nameIdKey(id.first,id.second)) != 0);
+  }
+  NameId encapsulationParent(NameId component) const
+  {
+    std::unordered_map<NameId,NameId>::const_iterator i =
+      mEncapsulationParents.find(component);
+    if (i == mEncapsulationParents.end()) return mInterfaceComponentId;
+    return i->second;
+  }
+  /* the component ref for the given component in the interface model's
+     encapsulation hierarchy, creating it (after its parent's) if need be */
+  iface::cellml_api::ComponentRef* componentRef(NameId component)
+  {
+    if (component == mInterfaceComponentId) return mEncapsInterface;
+    ComponentRefMap::const_iterator i = mComponentRefs.find(component);
+    if (i != mComponentRefs.end()) return i->second;
+    iface::cellml_api::ComponentRef* parent =
+      componentRef(encapsulationParent(component));
+    RETURN_INTO_OBJREF(ref,iface::cellml_api::ComponentRef,
+      mInterface->createComponentRef());
+    ref->componentName(mNames.name(component));
+    addElement(parent,ref);
+    mComponentRefs[component] = ref;
+    return ref;
+  }
+  /* pass the given document on to the output, if it hasn't been already */
+  void emit(OutputPipeline& output,size_t d)
+  {
+    if (mEmitted[d]) return;
+    NamedModel& document = mDocuments[d];
+    if (mKept.count(document.first)) output.keep(document.first);
+    else output.submit(document.first,std::move(document.second));
+    document.second = NULL;
+    mEmitted[d] = true;
+  }
+  // the connection tables and experiment mappings live here, and are
+  // released all at once at the end of the decomposition
+  Arena& mArena;
+  ObjRef<iface::cellml_api::CellMLBootstrap> mCB;
+  ObjRef<iface::cellml_api::Model> mBCs;
+  ObjRef<iface::cellml_api::CellMLComponent> mParameters;
+  ObjRef<iface::cellml_api::CellMLComponent> mInitialValues;
+  ObjRef<iface::cellml_api::Model> mUnits;
+  ObjRef<iface::cellml_api::Model> mInterface;
+  ObjRef<iface::cellml_api::CellMLComponent> mInterfaceComponent;
+  std::wstring mInterfaceComponentName;
+  NameId mInterfaceComponentId;
+  ObjRef<iface::cellml_api::ComponentRef> mEncapsInterface;
+  ObjRef<iface::cellml_api::Model> mExperiment;
+  // the mappings of the parameters and initial values in the example
+  // experiment model
+  MappingList mExperimentParameters;
+  MappingList mExperimentInitialValues;
+  ModelList mModels;
+  NameAllocator mInterfaceNames;
+  NameAllocator mFileNames;
+  std::set<std::string> mKept;
+  // the documents in the order they are named and written, and which have
+  // already been passed on to the output
+  NamedModelList mDocuments;
+  std::vector<bool> mEmitted;
+  const VariableRoleIndex& mIndex;
+  NamePool& mNames;
+  ConnectionGraph mInterfaceConnections;
+  UnitsDependencies mUnitsDependencies;
+  std::wstring mUnitsFile;
+  // when keeping the source encapsulation hierarchy, the nearest relevant
+  // encapsulation parent of each component
+  bool mKeepEncapsulation;
+  std::unordered_map<NameId,NameId> mEncapsulationParents;
+  typedef std::unordered_map<NameId,
+                             ObjRef<iface::cellml_api::ComponentRef> >
+    ComponentRefMap;
+  ComponentRefMap mComponentRefs;
+  // the top-level parameters now supplied by the interface component
+  std::unordered_set<uint64_t> mExtractedParameters;
+  // the variables left out of their components
+  std::unordered_set<uint64_t> mPruned;
+};
+
+/* The description of a variable to be created in a new component, with its
+   names in the decomposition's NamePool */
+class NewVariable
+{
+public:
+  NewVariable(NameId n,NameId u,iface::cellml_api::VariableInterface pub,
+    iface::cellml_api::VariableInterface priv,NameId iv = NO_NAME) :
+    name(n), units(u), initialValue(iv), publicInterface(pub),
+    privateInterface(priv)
+  {
+  }
+  NameId name;
+  NameId units;
+  // NO_NAME if the variable has no initial value
+  NameId initialValue;
+  iface::cellml_api::VariableInterface publicInterface;
+  iface::cellml_api::VariableInterface privateInterface;
+};
+typedef std::vector<NewVariable> NewVariableList;
+
+/* Everything required to build the new model for a single source component.
+   The plan is made by reading the source model, then the new component can
+   be built independently of all other components and the shared updates
+   applied to the DecomposedModel in component order. */
+class ComponentWork
+{
+public:
+  // the source component is kept alive by the index
+  BorrowedRef<iface::cellml_api::CellMLComponent> source;
+  ObjRef<iface::cellml_api::CellMLComponent> component;
+  NewVariableList variables;
+  // the math and local units DOM elements to be copied into the component,
+  // which are in the source document until they have been imported into
+  // the new component's document
+  DOMNodeList nodes;
+  SharedUpdateList updates;
+  // the variables left out of the new component
+  VariableInfoList pruned;
+  // the name of the source component
+  std::wstring name;
+  // the name of the new component's document and the hash of the plan
+  // for it, when decomposing incrementally
+  std::string document;
+  ContentHash hash;
+  bool unchanged;
+};
+typedef std::vector<ComponentWork> ComponentWorkList;
+
+/* Plan the variables of a component placed directly under the interface
+   component, which get everything from and give everything to the interface
+   component. If the model's variable usage is given, the variables the
+   simulation doesn't need are left out. */
+static void planFlatVariables(ComponentWork& work,NamePool& names,
+  const VariableInfoList& variables,const VariableUsage* usage)
+{
+  VariableInfoList::const_iterator i = variables.begin();
+  for (;i!=variables.end();++i)
+  {
+    const VariableInfo* v = *i;
+    /* leaving a variable out also leaves out its connections, its interface
+       variable and any parameter value, and its equations are dropped when
+       the math is imported */
+    if (usage && !usage->used(v))
+    {
+      work.pruned.push_back(v);
+      continue;
+    }
+    switch (v->role)
+    {
+    case ROLE_BOUND:
+      /* we have a variable of integration special case
+         create the variable in the new component but ensure it gets
+         connected directly to the interface component.
+         FIXME: ignoring any initial value attribute that might be specified.
+       */
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        iface::cellml_api::INTERFACE_IN,iface::cellml_api::INTERFACE_OUT));
+      work.updates.push_back(SharedUpdate(BOUND_VARIABLE,v));
+      break;
+    case ROLE_STATE:
+      {
+        /* we have a state variable, so add its initial value to the BC
+           model and add the initial value variable and the original state
+           variable to the new component */
+        NameId ivName = names.initialValueName(v->nameId);
+        work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+          iface::cellml_api::INTERFACE_OUT,iface::cellml_api::INTERFACE_OUT,
+          ivName));
+        work.updates.push_back(SharedUpdate(CALCULATED_VARIABLE,v));
+        work.variables.push_back(NewVariable(ivName,v->unitsId,
+          iface::cellml_api::INTERFACE_IN,iface::cellml_api::INTERFACE_NONE));
+        work.updates.push_back(SharedUpdate(INITIAL_VALUE_VARIABLE,v));
+      }
+      break;
+    case ROLE_PARAMETER:
+      /* we have a parameter (FIXME: do we?) so add it to the BC model
+         and the new component without the initial value */
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        iface::cellml_api::INTERFACE_IN,iface::cellml_api::INTERFACE_OUT));
+      work.updates.push_back(SharedUpdate(PARAMETER_VARIABLE,v));
+      break;
+    case ROLE_COMPUTED:
+      /* we have a locally computed variable so add it straight in */
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        iface::cellml_api::INTERFACE_OUT,iface::cellml_api::INTERFACE_OUT));
+      /* FIXME: variables with locally defined units probably shouldn't be
+         exposed, and if they are then the units need to be bubbled up
+         also. */
+      if (!v->localUnits)
+        work.updates.push_back(SharedUpdate(CALCULATED_VARIABLE,v));
+      break;
+    case ROLE_IMPORTED:
+      /* FIXME: a variable coming from somewhere else? */
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        iface::cellml_api::INTERFACE_IN,iface::cellml_api::INTERFACE_OUT));
+      break;
+    }
+  }
+}
+
+/* Plan the variables of a component placed in the source encapsulation
+   hierarchy. They keep their source interfaces, so the source connections
+   still hold, except that the parameters and initial values of the
+   top-level components come from the interface component and whatever the
+   top-level components exported is made available from it. Nested
+   components are copied as they are. */
+static void planEncapsulatedVariables(ComponentWork& work,NamePool& names,
+  const VariableInfoList& variables,bool topLevel)
+{
+  VariableInfoList::const_iterator i = variables.begin();
+  for (;i!=variables.end();++i)
+  {
+    const VariableInfo* v = *i;
+    if (!topLevel)
+    {
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        v->publicInterface,v->privateInterface,v->initialValueId));
+      continue;
+    }
+    switch (v->role)
+    {
+    case ROLE_STATE:
+      {
+        NameId ivName = names.initialValueName(v->nameId);
+        work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+          v->publicInterface,v->privateInterface,ivName));
+        work.variables.push_back(NewVariable(ivName,v->unitsId,
+          iface::cellml_api::INTERFACE_IN,iface::cellml_api::INTERFACE_NONE));
+        work.updates.push_back(SharedUpdate(INITIAL_VALUE_VARIABLE,v));
+      }
+      break;
+    case ROLE_PARAMETER:
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        iface::cellml_api::INTERFACE_IN,v->privateInterface));
+      work.updates.push_back(SharedUpdate(PARAMETER_VARIABLE,v));
+      break;
+    default:
+      work.variables.push_back(NewVariable(v->nameId,v->unitsId,
+        v->publicInterface,v->privateInterface,v->initialValueId));
+      break;
+    }
+    /* FIXME: as for flat components, variables with locally defined units
+       aren't exposed */
+    if ((v->role != ROLE_PARAMETER) && !v->localUnits &&
+      (v->publicInterface == iface::cellml_api::INTERFACE_OUT))
+      work.updates.push_back(SharedUpdate(EXPOSED_VARIABLE,v));
+  }
+}
+
+/* Work out what needs to be done to build the new component for the given
+   source component, leaving out the unused variables of flat components if
+   the model's variable usage is given */
+void planComponent(ComponentWork& work,const VariableRoleIndex& index,
+  NamePool& names,ComponentPlacement placement,const VariableUsage* usage)
+{
+  iface::cellml_api::CellMLComponent* c = work.source;
+  /*
+   * First grab all the math in the component
+   */
+  RETURN_INTO_OBJREF(math,iface::cellml_api::MathList,c->math());
+  RETURN_INTO_OBJREF(mathIt,iface::cellml_api::MathMLElementIterator,
+    math->iterate());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(m,iface::mathml_dom::MathMLElement,mathIt->next());
+    if (m == NULL) break;
+    work.nodes.push_back(ObjRef<iface::dom::Node>(m));
+  }
+  // then iterate over all variables in the component
+  const VariableInfoList& variables = index.componentVariables(c);
+  if (placement == PLACE_FLAT)
+    planFlatVariables(work,names,variables,usage);
+  else planEncapsulatedVariables(work,names,variables,
+      placement == PLACE_TOP_LEVEL);
+  /*
+   * and any locally defined units
+   */
+  RETURN_INTO_OBJREF(units,iface::cellml_api::UnitsSet,c->units());
+  RETURN_INTO_OBJREF(ui,iface::cellml_api::UnitsIterator,
+    units->iterateUnits());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(u,iface::cellml_api::Units,ui->nextUnits());
+    if (u == NULL) break;
+    // get the dom element for the old units element
+    DECLARE_QUERY_INTERFACE(unitsDE,u,cellml_api::CellMLDOMElement);
+    RETURN_INTO_OBJREF(uElement,iface::dom::Element,unitsDE->domElement());
+    unitsDE->release_ref();
+    work.nodes.push_back(ObjRef<iface::dom::Node>(uElement));
+  }
+}
+
+/* Hash everything in the plan which goes into the new component's document,
+   including the units imports it will be given, so we can tell if it needs
+   to be rebuilt */
+ContentHash hashComponentWork(const ComponentWork& work,
+  const NamePool& names,const UnitsDependencies& units,ContentHash hash)
+{
+  std::set<std::wstring> references;
+  NewVariableList::const_iterator i = work.variables.begin();
+  for (;i!=work.variables.end();++i)
+  {
+    std::wstring unitsName = names.name(i->units);
+    references.insert(unitsName);
+    hash = hashString(names.name(i->name),hash);
+    hash = hashString(unitsName,hash);
+    hash = hashString(i->initialValue == NO_NAME ? std::wstring() :
+      names.name(i->initialValue),hash);
+    hash = hashBytes(&(i->publicInterface),sizeof(i->publicInterface),hash);
+    hash = hashBytes(&(i->privateInterface),sizeof(i->privateInterface),hash);
+  }
+  DOMNodeList::const_iterator n = work.nodes.begin();
+  for (;n!=work.nodes.end();++n)
+  {
+    hash = hashNode(*n,hash);
+    findUnitsReferences(*n,references);
+  }
+  std::vector<std::wstring> imports = units.required(references);
+  std::vector<std::wstring>::const_iterator u = imports.begin();
+  for (;u!=imports.end();++u) hash = hashString(*u,hash);
+  return hash;
+}
+
+/* Copy the planned source DOM nodes into the new component's document,
+   leaving out the unused equations if the model's variable usage is given.
+   Reading the source nodes changes their reference counts, which are not
+   safe to share between threads, so this is done for one component at a
+   time before the components are built. */
+void importComponentNodes(ComponentWork& work,const VariableUsage* usage)
+{
+  DECLARE_QUERY_INTERFACE(componentDE,work.component,
+    cellml_api::CellMLDOMElement);
+  RETURN_INTO_OBJREF(componentElement,iface::dom::Element,
+    componentDE->domElement());
+  componentDE->release_ref();
+  RETURN_INTO_OBJREF(domDoc,iface::dom::Document,
+    componentElement->ownerDocument());
+  DOMNodeList::iterator n = work.nodes.begin();
+  for (;n!=work.nodes.end();++n)
+  {
+    // import the old node into the new dom document in the 1.1 namespace
+    *n = already_AddRefd<iface::dom::Node>(importNodeCellML11(domDoc,*n));
+    if (usage) usage->removeUnusedEquations(*n,work.name);
+  }
+}
+
+/* Build the new component as described by the given plan, once its nodes
+   have been imported. This only touches the new component's own model
+   document, so can be run for several components at once. */
+void buildComponent(ComponentWork& work,const NamePool& names)
+{
+  iface::cellml_api::CellMLComponent* nc = work.component;
+  RETURN_INTO_OBJREF(ncModel,iface::cellml_api::Model,nc->modelElement());
+  NewVariableList::const_iterator i = work.variables.begin();
+  for (;i!=work.variables.end();++i)
+  {
+    RETURN_INTO_OBJREF(nv,iface::cellml_api::CellMLVariable,
+      ncModel->createCellMLVariable());
+    nv->name(names.name(i->name));
+    nv->publicInterface(i->publicInterface);
+    nv->privateInterface(i->privateInterface);
+    nv->unitsName(names.name(i->units));
+    if (i->initialValue != NO_NAME)
+      nv->initialValue(names.name(i->initialValue));
+    addElement(nc,nv);
+  }
+  // shift to working in the DOM
+  DECLARE_QUERY_INTERFACE(componentDE,nc,cellml_api::CellMLDOMElement);
+  RETURN_INTO_OBJREF(componentElement,iface::dom::Element,
+    componentDE->domElement());
+  componentDE->release_ref();
+  DOMNodeList::const_iterator n = work.nodes.begin();
+  for (;n!=work.nodes.end();++n)
+  {
+    // append the imported node to the new component's child list
+    RETURN_INTO_OBJREF(appended,iface::dom::Node,
+      componentElement->appendChild(*n));
+  }
+}
+
+/* Record the memory use at the end of a phase, printing the report and
+   returning false if we have gone over budget */
+static bool memoryCheckpoint(MemoryReport& memory,const char* phase)
+{
+  if (memory.checkpoint(phase)) return true;
+  memory.print();
+  return false;
+}
+
+/* Create the given directory (and any missing parents), returning false if
+   it does not exist and couldn't be created */
+bool makeDirectory(const std::string& dir)
+{
+  struct stat sb;
+  if (dir.empty() || (stat(dir.c_str(),&sb) == 0)) return true;
+  size_t slash = dir.find_last_of('/');
+  if ((slash != std::string::npos) && (slash > 0))
+    makeDirectory(dir.substr(0,slash));
+  if ((mkdir(dir.c_str(),0755) != 0) && (errno != EEXIST)) return false;
+  return true;
+}
+
+/* Work out a default output directory name for a model URL from the final
+   path segment of the URL minus any extension */
+std::string defaultOutputDirectory(const std::string& root,
+  const std::string& url)
+{
+  std::string name = url;
+  size_t slash = name.find_last_of('/');
+  if (slash != std::string::npos) name = name.substr(slash+1);
+  size_t dot = name.find_last_of('.');
+  if ((dot != std::string::npos) && (dot > 0)) name = name.substr(0,dot);
+  if (name.empty()) name = "model";
+  return(root + "/" + name);
+}
+
+Decomposer::Decomposer(const DecomposeOptions& options) : mOptions(options),
+  mImports(options.jobs)
+{
+  mCB = already_AddRefd<iface::cellml_api::CellMLBootstrap>(
+    CreateCellMLBootstrap());
+  mCBS = already_AddRefd<iface::cellml_services::CeVASBootstrap>(
+    CreateCeVASBootstrap());
+  mCGB = already_AddRefd<iface::cellml_services::CodeGeneratorBootstrap>(
+    CreateCodeGeneratorBootstrap());
+}
+
+iface::cellml_api::Model* Decomposer::load(const std::wstring& URL,
+  const std::wstring* text)
+{
+  RETURN_INTO_OBJREF(ml,iface::cellml_api::DOMModelLoader,mCB->modelLoader());
+  ObjRef<iface::cellml_api::Model> mod;
+  try
+  {
+    {
+      ProfileScope profile("loadFromURL");
+      if (text)
+      {
+        mod = already_AddRefd<iface::cellml_api::Model>(
+          ml->createFromText(text->c_str()));
+        // imports are relative to where the model would have come from
+        RETURN_INTO_OBJREF(base,iface::cellml_api::URI,mod->base_uri());
+        base->asText(URL.c_str());
+      }
+      else
+      {
+        mod = already_AddRefd<iface::cellml_api::Model>(
+          ml->loadFromURL(URL.c_str()));
+      }
+    }
+    ProfileScope profile("fullyInstantiateImports");
+    mImports.instantiate(mod);
+    mod->fullyInstantiateImports(); // just in case
+  }
+  catch (...)
+  {
+    printf("Error loading model URL.\n");
+    return NULL;
+  }
+  mod->add_ref();
+  return mod;
+}
+
+int Decomposer::decompose(iface::cellml_api::Model* model,OutputSink& sink)
+{
+  RETURN_INTO_WSTRING(modelName,model->name());
+  ProfileScope profileModel(modelName,"model");
+  MemoryReport memory(mOptions.memoryBudget,mOptions.memoryReport);
+  return decompose(model,sink,memory);
+}
+
+int Decomposer::decompose(const std::wstring& URL,OutputSink& sink)
+{
+  ProfileScope profileModel(URL,"model");
+  MemoryReport memory(mOptions.memoryBudget,mOptions.memoryReport);
+  RETURN_INTO_OBJREF(mod,iface::cellml_api::Model,load(URL,NULL));
+  if ((mod == NULL) || !memoryCheckpoint(memory,"load")) return -1;
+  return decompose(mod,sink,memory);
+}
+
+int Decomposer::decomposeText(const std::wstring& text,
+  const std::wstring& baseURL,OutputSink& sink)
+{
+  ProfileScope profileModel(baseURL,"model");
+  MemoryReport memory(mOptions.memoryBudget,mOptions.memoryReport);
+  RETURN_INTO_OBJREF(mod,iface::cellml_api::Model,load(baseURL,&text));
+  if ((mod == NULL) || !memoryCheckpoint(memory,"load")) return -1;
+  return decompose(mod,sink,memory);
+}
+
+int Decomposer::decomposeToDirectory(const std::wstring& URL,
+  const std::string& dir)
+{
+  ProfileScope profileModel(URL,"model");
+  MemoryReport memory(mOptions.memoryBudget,mOptions.memoryReport);
+  RETURN_INTO_OBJREF(mod,iface::cellml_api::Model,load(URL,NULL));
+  if ((mod == NULL) || !memoryCheckpoint(memory,"load")) return -1;
+
+  // when decomposing incrementally, find out what we wrote last time
+  Manifest previous;
+  if (mOptions.incremental &&
+    !previous.load(dir + "/" + MANIFEST_NAME))
+    std::cout << "No previous manifest, writing all documents" << std::endl;
+  std::unique_ptr<OutputSink> sink;
+  if (mOptions.archive)
+  {
+    RETURN_INTO_WSTRING(modelName,mod->name());
+    sink.reset(new TarSink(dir + "/" + narrow(modelName) + ".tar"));
+  }
+  else if (mOptions.incremental) sink.reset(new IncrementalSink(dir,previous));
+  else sink.reset(new DirectorySink(dir));
+  return decompose(mod,*sink,memory);
+}
+
+int Decomposer::decompose(iface::cellml_api::Model* mod,OutputSink& sink,
+  MemoryReport& memory)
+{
+  const DecomposeOptions& options = mOptions;
+  long importedNodes = profileCounter(PROFILE_IMPORT_NODE);
+
+  // the names of components and variables for the connection tables
+  /* the names and the plan of the decomposition are kept in an arena,
+     which is released in one go at the end */
+  Arena arena;
+  NamePool names(arena);
+  VariableRoleIndex index(names);
+  // the analysis of an unchanged model may already be cached
+  ContentHash cacheKey = 0;
+  bool cached = false;
+  if (options.cache)
+  {
+    ProfileScope profile("loadAnalysisCache");
+    cacheKey = options.cache->key(mod,options.classifier);
+    cached = options.cache->load(cacheKey,mod,index);
+  }
+  if (!cached)
+  {
+    // create a CeVAS so we can navigate variable connections
+    ObjRef<iface::cellml_services::CeVAS> cevas;
+    {
+      ProfileScope profile("createCeVAS");
+      cevas = already_AddRefd<iface::cellml_services::CeVAS>(
+        mCBS->createCeVASForModel(mod));
+    }
+
+    // we need to create a list of state variables so we can distinguish
+    // initial conditions from model parameters ??? FIXME: really? 
+    VariableList stateVariables;
+    VariableList boundVariables;
+    {
+      ProfileScope profile("classifyVariables");
+      if (!classifyVariables(options.classifier,mod,cevas,mCGB,
+        stateVariables,boundVariables))
+        return -1;
+    }
+    // and then work out the role of every variable in the model
+    {
+      ProfileScope profile("buildIndex");
+      index.build(cevas,stateVariables,boundVariables);
+    }
+    if (options.cache)
+      options.cache->store(cacheKey,mod,index,stateVariables,
+        boundVariables);
+  }
+  if (!memoryCheckpoint(memory,"analysis")) return -1;
+
+  /*
+   * create the object to hold the decomposed model documents
+   */
+  RETURN_INTO_WSTRING(modelName,mod->name());
+  DecomposedModel dm(mCB,modelName,index,names,arena,
+    options.keepEncapsulation);
+
+  // component documents depend on the model name and the version of
+  // decompose as well as their plan
+  ContentHash seed = hashString(modelName + string2wstring(
+      getVersion().c_str()));
+
+  /* the models are serialised while they are written out, and when
+     streaming this starts with the first component. Only the documents
+     which have changed are built for an incremental sink. */
+  IncrementalSink* incrementalSink = dynamic_cast<IncrementalSink*>(&sink);
+  OutputPipeline output(sink,options.jobs);
+
+  /*
+   * the units come first, so that each component model can be finished as
+   * soon as it is built
+   */
+  {
+    // add all the units the units model
+    ProfileScope profile("addUnits");
+    RETURN_INTO_OBJREF(units,iface::cellml_api::UnitsSet,mod->allUnits());
+    RETURN_INTO_OBJREF(unitsI,iface::cellml_api::UnitsIterator,
+      units->iterateUnits());
+    while (true)
+    {
+      RETURN_INTO_OBJREF(u,iface::cellml_api::Units,unitsI->nextUnits());
+      if (u == NULL) break;
+      dm.addUnits(u);
+    }
+  }
+
+  /* find what the simulation needs, if the rest is to be left out of the
+     flattened components */
+  std::unique_ptr<VariableUsage> usage;
+  if (options.prune && !options.keepEncapsulation)
+  {
+    ProfileScope profile("findUsedVariables");
+    usage.reset(new VariableUsage(index,names));
+  }
+
+  // plan the new model for each of the relevant components in the model
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+    relevantComponents = index.components();
+  ComponentWorkList components(relevantComponents.size());
+  {
+    ProfileScope profile("planComponents");
+    for (size_t i=0;i<relevantComponents.size();++i)
+    {
+      ComponentWork& work = components[i];
+      work.source = relevantComponents[i];
+      // create the component's own model and component within that model
+      work.component = already_AddRefd<iface::cellml_api::CellMLComponent>(
+        dm.addComponent(work.source));
+      planComponent(work,index,names,dm.placement(work.source),usage.get());
+      dm.prune(work.pruned);
+      GET_SET_WSTRING(work.source->name(),work.name);
+      work.hash = 0;
+      work.unchanged = false;
+    }
+  }
+  // all the documents can now be named
+  {
+    std::vector<std::string> names = dm.nameDocuments();
+    if (!output.begin(names)) return -1;
+    for (size_t i=0;i<components.size();++i)
+      components[i].document = dm.componentDocument(i);
+  }
+  if (options.stream) dm.emitUnits(output);
+
+  /* build all the new components, which are independent of each other. When
+     streaming they are built a few at a time and each one is finished and
+     passed on to be written out straight away, otherwise they are all built
+     at once and kept until the end. */
+  size_t chunk = components.size();
+  if (options.stream) chunk = 4*effectiveJobs(options.jobs);
+  for (size_t first=0;first<components.size();first+=chunk)
+  {
+    size_t count = std::min(chunk,components.size()-first);
+    {
+      /* everything reading the source DOM is done here, one component at
+         a time, so the builds only touch their own documents */
+      ProfileScope profile("importComponentNodes");
+      for (size_t i=first;i<first+count;++i)
+      {
+        ComponentWork& work = components[i];
+        if (incrementalSink)
+        {
+          work.hash = hashComponentWork(work,names,dm.unitsDependencies(),
+            seed);
+          work.unchanged = incrementalSink->unchanged(work.document,
+            work.hash);
+        }
+        if (!work.unchanged) importComponentNodes(work,usage.get());
+      }
+    }
+    try
+    {
+      ProfileScope profile("buildComponents");
+      parallelFor(count,options.jobs,[&](size_t i)
+        {
+          ComponentWork& work = components[first+i];
+          if (work.unchanged) return;
+          ProfileScope profileComponent(work.name,"component");
+          // stop before we run out of memory rather than part way through
+          if (options.memoryBudget && !memory.withinBudget())
+            throw std::bad_alloc();
+          buildComponent(work,names);
+          if (options.stream)
+          {
+            RETURN_INTO_OBJREF(model,iface::cellml_api::Model,
+              work.component->modelElement());
+            dm.createUnitsImportsForModel(model);
+          }
+        });
+    }
+    catch (...)
+    {
+      ReportLine() << "Error building the decomposed component models.";
+      memoryCheckpoint(memory,"buildComponents");
+      return -1;
+    }
+    // and then update the shared state, in the original component order
+    ProfileScope profile("applySharedUpdates");
+    for (size_t i=first;i<first+count;++i)
+    {
+      ComponentWork& work = components[i];
+      dm.applySharedUpdates(work.updates);
+      if (incrementalSink) incrementalSink->input(work.document,work.hash);
+      if (work.unchanged) dm.keep(work.document);
+      if (options.stream)
+      {
+        /* let go of everything to do with this component before it is
+           handed over to be written, as the serialiser threads may be
+           working on it straight away (the document list still holds the
+           model until then) */
+        std::string document = std::move(work.document);
+        work = ComponentWork();
+        work.document = std::move(document);
+        dm.emitComponent(output,i);
+      }
+    }
+  }
+  if (!memoryCheckpoint(memory,"buildComponents")) return -1;
+
+  {
+    // create all the units imports not already made
+    ProfileScope profile("createUnitsImports");
+    dm.createUnitsImports();
+  }
+  if (!memoryCheckpoint(memory,"units")) return -1;
+
+  /* instantiate all the connections */
+  {
+    ProfileScope profile("createConnections");
+    if (options.keepEncapsulation) dm.addSourceConnections(mod);
+    dm.createConnections();
+  }
+  if (!memoryCheckpoint(memory,"connections")) return -1;
+  profileCount(PROFILE_CONNECTIONS,dm.connectionCount());
+  profileCount(PROFILE_MAPPINGS,dm.mappingCount());
+  ReportLine() << "Interface connections: " << dm.connectionCount()
+               << " with " << dm.mappingCount() << " variable mappings";
+  if (usage)
+  {
+    profileCount(PROFILE_PRUNED,dm.prunedCount());
+    ReportLine() << "Pruned " << dm.prunedCount() << " unused variables and "
+                 << usage->unusedEquations() << " equations";
+  }
+
+  {
+    ProfileScope profile("dump");
+    if (!dm.dump(output)) return -1;
+    memory.note("generated models held",dm.modelCount());
+    memory.note("plan arena bytes",arena.size());
+    memory.note("DOM nodes imported",
+      profileCounter(PROFILE_IMPORT_NODE) - importedNodes);
+    memory.note("serialised bytes",output.serialisedBytes());
+    memory.note("largest document bytes",output.largestDocument());
+    memory.note("peak pending bytes",output.peakPendingBytes());
+  }
+  if (!memoryCheckpoint(memory,"dump")) return -1;
+  if (options.memoryReport) memory.print();
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _DECOMPOSER_HPP_
+#define _DECOMPOSER_HPP_
+
+#include <string>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCCGS.hxx>
+#include <CeVASBootstrap.hpp>
+
+#include "utils.hxx"
+#include "decompose.hpp"
+#include "output.hpp"
+#include "imports.hpp"
+
+class MemoryReport;
+
+/* The decomposition library. A Decomposer holds the bootstrap objects,
+   which are shared by all the models it decomposes, and passes the
+   documents generated for each model on to an output sink - a MemorySink
+   to keep them in memory, a DirectorySink to write them to files and so
+   on. The command line tool is just a wrapper around this.
+
+   Each of the decompose methods returns zero on success. */
+class Decomposer
+{
+public:
+  Decomposer(const DecomposeOptions& options = DecomposeOptions());
+  const DecomposeOptions& options() const
+  {
+    return mOptions;
+  }
+  /* the CellML bootstrap, which callers can use to load their own models
+     or read the generated documents back in */
+  iface::cellml_api::CellMLBootstrap* bootstrap()
+  {
+    return mCB;
+  }
+  /* decompose an already loaded model, which must have all its imports
+     instantiated. An IncrementalSink is only given the documents which
+     have changed. */
+  int decompose(iface::cellml_api::Model* model,OutputSink& sink);
+  /* load and decompose the model at the given URL */
+  int decompose(const std::wstring& URL,OutputSink& sink);
+  /* decompose the model given as text, resolving its imports relative to
+     the given base URL */
+  int decomposeText(const std::wstring& text,const std::wstring& baseURL,
+    OutputSink& sink);
+  /* decompose the model at the given URL into files in the given directory,
+     or an archive or an incremental update of the directory as asked for in
+     the options */
+  int decomposeToDirectory(const std::wstring& URL,const std::string& dir);
+private:
+  /* load the model at the given URL, or from the given text if any, and
+     instantiate its imports, returning NULL on failure */
+  iface::cellml_api::Model* load(const std::wstring& URL,
+    const std::wstring* text);
+  int decompose(iface::cellml_api::Model* model,OutputSink& sink,
+    MemoryReport& memory);
+  DecomposeOptions mOptions;
+  ObjRef<iface::cellml_api::CellMLBootstrap> mCB;
+  ObjRef<iface::cellml_services::CeVASBootstrap> mCBS;
+  ObjRef<iface::cellml_services::CodeGeneratorBootstrap> mCGB;
+  // shared by all the models decomposed, so common imports are only read
+  // once
+  ImportLoader mImports;
+};
+
+/* Create the given directory (and any missing parents), returning false if
+   it does not exist and couldn't be created */
+bool makeDirectory(const std::string& dir);
+
+/* Work out a default output directory name, under the given root, for a
+   model URL from the final path segment of the URL minus any extension */
+std::string defaultOutputDirectory(const std::string& root,
+  const std::string& url);
+
+#endif /* _DECOMPOSER_HPP_ */
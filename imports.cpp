@@ -0,0 +1,260 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "imports.hpp"
+#include "strings.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+
+/* remove the "." and ".." segments from a path */
+static std::wstring normalisePath(const std::wstring& path)
+{
+  std::vector<std::wstring> segments;
+  size_t start = 0;
+  while (start <= path.size())
+  {
+    size_t slash = path.find(L'/',start);
+    if (slash == std::wstring::npos) slash = path.size();
+    std::wstring segment = path.substr(start,slash-start);
+    if (segment == L"..")
+    {
+      // never above the root of an absolute path
+      bool root = (segments.size() == 1) && segments[0].empty();
+      if (segments.empty() || (segments.back() == L".."))
+        segments.push_back(segment);
+      else if (!root) segments.pop_back();
+    }
+    else if ((segment != L".") || (slash == path.size()))
+      segments.push_back((segment == L".") ? L"" : segment);
+    start = slash + 1;
+  }
+  std::wstring normalised;
+  for (size_t i=0;i<segments.size();++i)
+  {
+    if (i > 0) normalised += L'/';
+    normalised += segments[i];
+  }
+  return normalised;
+}
+
+std::wstring resolveURL(const std::wstring& base,const std::wstring& href)
+{
+  if (href.find(L"://") != std::wstring::npos) return href;
+  // keep the scheme and authority of the base
+  std::wstring prefix, path = base;
+  size_t scheme = base.find(L"://");
+  if (scheme != std::wstring::npos)
+  {
+    size_t slash = base.find(L'/',scheme+3);
+    if (slash == std::wstring::npos) slash = base.size();
+    prefix = base.substr(0,slash);
+    path = (slash < base.size()) ? base.substr(slash) : L"/";
+  }
+  if (!href.empty() && (href[0] == L'/')) path = href;
+  else
+  {
+    size_t slash = path.find_last_of(L'/');
+    path = ((slash == std::wstring::npos) ? L"" : path.substr(0,slash+1)) +
+      href;
+  }
+  return prefix + normalisePath(path);
+}
+
+/* find the file for a file: URL or plain path, returning false for any
+   other URL */
+static bool localPath(const std::wstring& url,std::string& path)
+{
+  std::wstring p = url;
+  if (p.compare(0,7,L"file://") == 0) p = p.substr(7);
+  else if (p.find(L"://") != std::wstring::npos) return false;
+  // undo any percent encoding
+  std::string utf8 = wstringToUTF8(p);
+  path.clear();
+  for (size_t i=0;i<utf8.size();++i)
+  {
+    if ((utf8[i] == '%') && (i+2 < utf8.size()))
+    {
+      path += (char)strtol(utf8.substr(i+1,2).c_str(),NULL,16);
+      i += 2;
+    }
+    else path += utf8[i];
+  }
+  return !path.empty();
+}
+
+std::shared_ptr<const std::wstring> ImportLoader::fetch(
+  const std::wstring& url)
+{
+  std::shared_ptr<const std::wstring> none;
+  std::string path;
+  struct stat sb;
+  if (!localPath(url,path) || (stat(path.c_str(),&sb) != 0)) return none;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<std::wstring,Document>::iterator d = mDocuments.find(url);
+    if ((d != mDocuments.end()) && (d->second.modified == sb.st_mtime) &&
+      (d->second.size == sb.st_size))
+    {
+      profileCount(PROFILE_IMPORTS_CACHED);
+      d->second.used = ++mUses;
+      return d->second.text;
+    }
+  }
+  std::ifstream in(path.c_str(),std::ios::binary);
+  if (!in) return none;
+  std::ostringstream data;
+  data << in.rdbuf();
+  std::string utf8 = data.str();
+  // skip any byte order mark
+  if (utf8.compare(0,3,"\xEF\xBB\xBF") == 0) utf8 = utf8.substr(3);
+  std::shared_ptr<std::wstring> text(new std::wstring);
+  // documents in other encodings are left to the CellML API
+  if (!UTF8ToWstring(utf8,*text)) return none;
+  profileCount(PROFILE_IMPORTS_READ);
+  std::lock_guard<std::mutex> lock(mMutex);
+  Document& document = mDocuments[url];
+  if (document.text) mBytes -= document.text->size()*sizeof(wchar_t);
+  document.modified = sb.st_mtime;
+  document.size = sb.st_size;
+  document.text = text;
+  document.used = ++mUses;
+  mBytes += text->size()*sizeof(wchar_t);
+  evict();
+  return text;
+}
+
+void ImportLoader::evict()
+{
+  // anything still being used keeps its own reference to the text
+  while ((mBytes > mLimit) && !mDocuments.empty())
+  {
+    std::map<std::wstring,Document>::iterator oldest = mDocuments.begin();
+    std::map<std::wstring,Document>::iterator d = mDocuments.begin();
+    for (;d!=mDocuments.end();++d)
+      if (d->second.used < oldest->second.used) oldest = d;
+    mBytes -= oldest->second.text->size()*sizeof(wchar_t);
+    mDocuments.erase(oldest);
+  }
+}
+
+/* an import yet to be instantiated and the URL it resolves to */
+typedef std::pair<ObjRef<iface::cellml_api::CellMLImport>,std::wstring>
+  PendingImport;
+typedef std::vector<PendingImport> PendingImportList;
+
+/* find the imports of the given model which still need instantiating */
+static void findImports(iface::cellml_api::Model* model,
+  PendingImportList& pending)
+{
+  RETURN_INTO_OBJREF(baseURI,iface::cellml_api::URI,model->base_uri());
+  RETURN_INTO_WSTRING(base,baseURI->asText());
+  RETURN_INTO_OBJREF(imports,iface::cellml_api::CellMLImportSet,
+    model->imports());
+  RETURN_INTO_OBJREF(ii,iface::cellml_api::CellMLImportIterator,
+    imports->iterateImports());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(imp,iface::cellml_api::CellMLImport,ii->nextImport());
+    if (imp == NULL) break;
+    if (imp->wasInstantiated())
+    {
+      RETURN_INTO_OBJREF(imported,iface::cellml_api::Model,
+        imp->importedModel());
+      if (imported) findImports(imported,pending);
+      continue;
+    }
+    RETURN_INTO_OBJREF(href,iface::cellml_api::URI,imp->xlinkHref());
+    RETURN_INTO_WSTRING(url,href->asText());
+    pending.push_back(PendingImport(imp,resolveURL(base,url)));
+  }
+}
+
+void ImportLoader::instantiate(iface::cellml_api::Model* model)
+{
+  PendingImportList level;
+  findImports(model,level);
+  while (!level.empty())
+  {
+    // read each distinct document in this level of the import tree
+    std::vector<std::wstring> urls;
+    std::map<std::wstring,size_t> urlIndex;
+    PendingImportList::const_iterator i = level.begin();
+    for (;i!=level.end();++i)
+    {
+      if (urlIndex.count(i->second)) continue;
+      urlIndex[i->second] = urls.size();
+      urls.push_back(i->second);
+    }
+    std::vector< std::shared_ptr<const std::wstring> > texts(urls.size());
+    {
+      ProfileScope profile("fetchImports");
+      parallelFor(urls.size(),mJobs,[&](size_t u)
+        {
+          texts[u] = fetch(urls[u]);
+        });
+    }
+    // and then instantiate them, finding the next level as we go
+    PendingImportList next;
+    for (i=level.begin();i!=level.end();++i)
+    {
+      const std::shared_ptr<const std::wstring>& text =
+        texts[urlIndex[i->second]];
+      if (text) i->first->instantiateFromText(text->c_str());
+      else i->first->instantiate();
+      RETURN_INTO_OBJREF(imported,iface::cellml_api::Model,
+        i->first->importedModel());
+      if (imported == NULL) continue;
+      if (text)
+      {
+        // so the imported model's own imports resolve relative to it
+        RETURN_INTO_OBJREF(baseURI,iface::cellml_api::URI,
+          imported->base_uri());
+        baseURI->asText(i->second.c_str());
+      }
+      findImports(imported,next);
+    }
+    level.swap(next);
+  }
+}
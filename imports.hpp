@@ -0,0 +1,96 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _IMPORTS_HPP_
+#define _IMPORTS_HPP_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+/* Resolve an import's href against the base URL of the importing model */
+std::wstring resolveURL(const std::wstring& base,const std::wstring& href);
+
+/* Instantiates the imports of a model a level of the import tree at a time,
+   reading all the distinct documents needed for each level in parallel.
+   The text of each document is cached by its resolved URL, so a document
+   imported many times (or by many models, as the loader is kept for a whole
+   batch or server run) is only read and decoded once while it is
+   unchanged. The least recently used documents are dropped to keep the
+   cached text under the given number of bytes. Only local (file: or plain
+   path) documents are read this way, anything else is left to the CellML
+   API. Each import is still parsed and instantiated by the CellML API, one
+   at a time as it isn't thread safe, since there is no way to hand it an
+   already parsed document. */
+class ImportLoader
+{
+public:
+  ImportLoader(int jobs,size_t limit = 64*1024*1024) : mJobs(jobs),
+    mLimit(limit), mBytes(0), mUses(0)
+  {
+  }
+  void instantiate(iface::cellml_api::Model* model);
+private:
+  class Document
+  {
+  public:
+    time_t modified;
+    off_t size;
+    std::shared_ptr<const std::wstring> text;
+    // when the document was last fetched, for evicting the oldest
+    uint64_t used;
+  };
+  /* the text of the document at the given URL, or NULL if it isn't a local
+     document or couldn't be read */
+  std::shared_ptr<const std::wstring> fetch(const std::wstring& url);
+  /* drop the least recently used documents until the cache is within its
+     limit, called with the mutex held */
+  void evict();
+
+  int mJobs;
+  size_t mLimit;
+  std::mutex mMutex;
+  std::map<std::wstring,Document> mDocuments;
+  // the size of the cached text and the count of fetches so far
+  size_t mBytes;
+  uint64_t mUses;
+};
+
+#endif /* _IMPORTS_HPP_ */
@@ -0,0 +1,225 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "manifest.hpp"
+
+#define FNV_PRIME 1099511628211ULL
+
+ContentHash hashBytes(const void* data,size_t size,ContentHash hash)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i=0;i<size;++i)
+  {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+ContentHash hashString(const std::wstring& str,ContentHash hash)
+{
+  // include the length so that adjacent strings can't run together
+  size_t size = str.size();
+  hash = hashBytes(&size,sizeof(size),hash);
+  return hashBytes(str.data(),size*sizeof(wchar_t),hash);
+}
+
+ContentHash hashNode(iface::dom::Node* node,ContentHash hash)
+{
+  uint16_t type = node->nodeType();
+  if (type == iface::dom::Node::TEXT_NODE)
+  {
+    RETURN_INTO_WSTRING(text,node->nodeValue());
+    if (text.find_first_not_of(L" \t\r\n") == std::wstring::npos) return hash;
+  }
+  hash = hashBytes(&type,sizeof(type),hash);
+  RETURN_INTO_WSTRING(name,node->nodeName());
+  RETURN_INTO_WSTRING(ns,node->namespaceURI());
+  RETURN_INTO_WSTRING(value,node->nodeValue());
+  hash = hashString(name,hash);
+  hash = hashString(ns,hash);
+  hash = hashString(value,hash);
+  RETURN_INTO_OBJREF(attrs,iface::dom::NamedNodeMap,node->attributes());
+  uint32_t i,l = attrs ? attrs->length() : 0;
+  for (i=0;i<l;++i)
+  {
+    RETURN_INTO_OBJREF(attr,iface::dom::Node,attrs->item(i));
+    hash = hashNode(attr,hash);
+  }
+  RETURN_INTO_OBJREF(child,iface::dom::Node,node->firstChild());
+  while (child)
+  {
+    hash = hashNode(child,hash);
+    child = already_AddRefd<iface::dom::Node>(child->nextSibling());
+  }
+  // mark the end of the children
+  type = 0;
+  return hashBytes(&type,sizeof(type),hash);
+}
+
+bool Manifest::load(const std::string& file)
+{
+  mEntries.clear();
+  std::ifstream in(file.c_str());
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in,line))
+  {
+    // each line is: output-hash input-hash document-name
+    if (line.empty() || (line[0] == '#')) continue;
+    std::istringstream fields(line);
+    Entry e;
+    std::string name;
+    if (!(fields >> std::hex >> e.output >> e.input >> name)) return false;
+    mEntries[name] = e;
+  }
+  return true;
+}
+
+bool Manifest::save(const std::string& file) const
+{
+  FILE* f = fopen(file.c_str(),"w");
+  if (f == NULL) return false;
+  fprintf(f,"# decompose output manifest\n");
+  EntryMap::const_iterator i = mEntries.begin();
+  for (;i!=mEntries.end();++i)
+  {
+    fprintf(f,"%016" PRIx64 " %016" PRIx64 " %s\n",i->second.output,
+      i->second.input,i->first.c_str());
+  }
+  return (fclose(f) == 0);
+}
+
+const Manifest::Entry* Manifest::find(const std::string& name) const
+{
+  EntryMap::const_iterator i = mEntries.find(name);
+  if (i == mEntries.end()) return NULL;
+  return &(i->second);
+}
+
+static bool fileExists(const std::string& file)
+{
+  struct stat sb;
+  return (stat(file.c_str(),&sb) == 0);
+}
+
+IncrementalSink::IncrementalSink(const std::string& dir,
+  const Manifest& previous) :
+  mDir(dir), mPrevious(previous), mTarget(dir), mWritten(0), mUnchanged(0)
+{
+}
+
+void IncrementalSink::input(const std::string& name,ContentHash hash)
+{
+  // the writer thread may be looking up other documents' inputs
+  std::lock_guard<std::mutex> lock(mMutex);
+  mInputs[name] = hash;
+}
+
+bool IncrementalSink::unchanged(const std::string& dir,
+  const Manifest& previous,const std::string& name,ContentHash input)
+{
+  const Manifest::Entry* e = previous.find(name);
+  return (e && (e->input != 0) && (e->input == input) &&
+    fileExists(dir + "/" + name));
+}
+
+bool IncrementalSink::write(const std::string& name,const std::string& data)
+{
+  Manifest::Entry& e = mManifest[name];
+  e.output = hashBytes(data.data(),data.size());
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<std::string,ContentHash>::const_iterator i = mInputs.find(name);
+    if (i != mInputs.end()) e.input = i->second;
+  }
+  const Manifest::Entry* old = mPrevious.find(name);
+  if (old && (old->output == e.output) && fileExists(mDir + "/" + name))
+  {
+    mUnchanged++;
+    return true;
+  }
+  mWritten++;
+  return mTarget.write(name,data);
+}
+
+bool IncrementalSink::keep(const std::string& name)
+{
+  const Manifest::Entry* old = mPrevious.find(name);
+  if (old == NULL) return false;
+  mManifest[name] = *old;
+  mUnchanged++;
+  return true;
+}
+
+bool IncrementalSink::finish()
+{
+  // remove anything we wrote last time that is no longer generated
+  Manifest::EntryMap::const_iterator i = mPrevious.entries().begin();
+  for (;i!=mPrevious.entries().end();++i)
+  {
+    if (mManifest.find(i->first)) continue;
+    // we only ever write documents into the output directory itself, so
+    // don't trust a manifest naming anything else
+    if ((i->first.find('/') != std::string::npos) ||
+      (i->first.find("..") != std::string::npos))
+    {
+      ReportLine(std::cerr) << "Not removing file outside the output "
+                            << "directory: " << i->first;
+      continue;
+    }
+    std::string file = mDir + "/" + i->first;
+    ReportLine() << "Removing stale file: " << file;
+    remove(file.c_str());
+  }
+  ReportLine() << "Incremental output: " << mWritten << " written, "
+               << mUnchanged << " unchanged";
+  std::string file = mDir + "/" + MANIFEST_NAME;
+  if (!mManifest.save(file))
+  {
+    ReportLine(std::cerr) << "ERROR writing manifest: " << file;
+    return false;
+  }
+  return true;
+}
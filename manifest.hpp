@@ -0,0 +1,130 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _MANIFEST_HPP_
+#define _MANIFEST_HPP_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <inttypes.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "output.hpp"
+
+/* The file, in the output directory, recording what was written */
+#define MANIFEST_NAME "decompose-manifest.txt"
+
+/* 64 bit FNV-1a hashes of the documents and their inputs */
+typedef uint64_t ContentHash;
+#define CONTENT_HASH_SEED 14695981039346656037ULL
+
+ContentHash hashBytes(const void* data,size_t size,
+  ContentHash hash = CONTENT_HASH_SEED);
+ContentHash hashString(const std::wstring& str,
+  ContentHash hash = CONTENT_HASH_SEED);
+/* hash the given DOM node and all its descendants, ignoring white space
+   only text */
+ContentHash hashNode(iface::dom::Node* node,
+  ContentHash hash = CONTENT_HASH_SEED);
+
+/* The hashes of each document written to an output directory, and of the
+   inputs to those documents which we can check before building them */
+class Manifest
+{
+public:
+  class Entry
+  {
+  public:
+    Entry() : output(0), input(0)
+    {
+    }
+    ContentHash output;
+    // zero when the document's inputs weren't hashed
+    ContentHash input;
+  };
+  typedef std::map<std::string,Entry> EntryMap;
+  /* read the manifest from the given file, returning false if there is no
+     usable manifest */
+  bool load(const std::string& file);
+  bool save(const std::string& file) const;
+  const Entry* find(const std::string& name) const;
+  Entry& operator[](const std::string& name)
+  {
+    return mEntries[name];
+  }
+  const EntryMap& entries() const
+  {
+    return mEntries;
+  }
+private:
+  EntryMap mEntries;
+};
+
+/* An output sink for incremental decomposition into a directory. Documents
+   whose content hasn't changed since the previous manifest are left alone,
+   documents no longer generated are removed and a new manifest is written
+   when finished. */
+class IncrementalSink : public OutputSink
+{
+public:
+  IncrementalSink(const std::string& dir,const Manifest& previous);
+  /* record the hash of the inputs of the named document, before it is
+     submitted for writing */
+  void input(const std::string& name,ContentHash hash);
+  virtual bool write(const std::string& name,const std::string& data);
+  virtual bool keep(const std::string& name);
+  virtual bool finish();
+  /* can the named document be left as it is, given the hash of its
+     inputs? */
+  static bool unchanged(const std::string& dir,const Manifest& previous,
+    const std::string& name,ContentHash input);
+  bool unchanged(const std::string& name,ContentHash input) const
+  {
+    return unchanged(mDir,mPrevious,name,input);
+  }
+private:
+  std::string mDir;
+  const Manifest& mPrevious;
+  std::mutex mMutex;
+  std::map<std::string,ContentHash> mInputs;
+  DirectorySink mTarget;
+  Manifest mManifest;
+  int mWritten;
+  int mUnchanged;
+};
+
+#endif /* _MANIFEST_HPP_ */
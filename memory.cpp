@@ -0,0 +1,140 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "memory.hpp"
+
+/* read the given field, in kB, from /proc/self/status */
+static long statusField(const char* field)
+{
+  FILE* f = fopen("/proc/self/status","r");
+  if (f == NULL) return 0;
+  char line[256];
+  long value = 0;
+  size_t n = strlen(field);
+  while (fgets(line,sizeof(line),f))
+  {
+    if ((strncmp(line,field,n) == 0) && (line[n] == ':'))
+    {
+      value = atol(line+n+1);
+      break;
+    }
+  }
+  fclose(f);
+  return value;
+}
+
+long memoryCurrent()
+{
+  return statusField("VmRSS");
+}
+
+long memoryPeak()
+{
+  return statusField("VmHWM");
+}
+
+bool memoryResetPeak()
+{
+  FILE* f = fopen("/proc/self/clear_refs","w");
+  if (f == NULL) return false;
+  bool ok = (fputs("5",f) >= 0);
+  return ((fclose(f) == 0) && ok);
+}
+
+/* each report starts the peak afresh, so earlier models decomposed by the
+   same process don't count against it */
+MemoryReport::MemoryReport(long budget,bool report) : mBudget(budget),
+  mActive((budget > 0) || report), mExceeded(false),
+  mPhasePeaks(mActive && memoryResetPeak())
+{
+}
+
+bool MemoryReport::checkpoint(const std::string& phase)
+{
+  if (!mActive) return true;
+  Checkpoint c;
+  c.phase = phase;
+  c.current = memoryCurrent();
+  c.peak = mPhasePeaks ? memoryPeak() : 0;
+  mCheckpoints.push_back(c);
+  /* without the phase's own peak all we can go on is the current use */
+  long used = mPhasePeaks ? c.peak : c.current;
+  if ((mBudget > 0) && (used > mBudget)) mExceeded = true;
+  if (mPhasePeaks) memoryResetPeak();
+  return !mExceeded;
+}
+
+bool MemoryReport::withinBudget() const
+{
+  return ((mBudget <= 0) || (memoryCurrent() <= mBudget));
+}
+
+void MemoryReport::note(const std::string& what,long value)
+{
+  mNotes.push_back(std::make_pair(what,value));
+}
+
+void MemoryReport::print() const
+{
+  std::ostream& out = mExceeded ? std::cerr : std::cout;
+  if (mExceeded)
+  {
+    out << "Memory budget of " << mBudget << " kB exceeded after phase: "
+        << (mCheckpoints.empty() ? "" : mCheckpoints.back().phase.c_str())
+        << std::endl;
+  }
+  out << "Memory use (kB):" << std::endl;
+  char line[128];
+  std::vector<Checkpoint>::const_iterator c = mCheckpoints.begin();
+  for (;c!=mCheckpoints.end();++c)
+  {
+    if (mPhasePeaks)
+      sprintf(line,"  %-24s RSS %10ld  phase peak %10ld",c->phase.c_str(),
+        c->current,c->peak);
+    else sprintf(line,"  %-24s RSS %10ld",c->phase.c_str(),c->current);
+    out << line << std::endl;
+  }
+  std::vector< std::pair<std::string,long> >::const_iterator n;
+  for (n=mNotes.begin();n!=mNotes.end();++n)
+  {
+    sprintf(line,"  %-24s %ld",n->first.c_str(),n->second);
+    out << line << std::endl;
+  }
+}
@@ -0,0 +1,92 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _MEMORY_HPP_
+#define _MEMORY_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+/* The current and peak resident set size of this process in kilobytes,
+   or zero if it can't be found */
+long memoryCurrent();
+long memoryPeak();
+/* Reset the peak resident set size to the current one, so memoryPeak()
+   gives the peak since then, returning false if this isn't supported */
+bool memoryResetPeak();
+
+/* Keeps track of the memory used by each phase of decomposing a model,
+   along with anything else worth knowing about where the memory went, and
+   checks it against an optional budget so we can fail with a useful
+   report rather than being killed when we run out of memory. Nothing is
+   measured unless there is a budget or the report is wanted, as measuring
+   the peak of each phase resets the peak for the whole process. */
+class MemoryReport
+{
+public:
+  /* the budget is in kilobytes, zero for no limit */
+  MemoryReport(long budget,bool report);
+  /* record the memory use at the end of the named phase, and its peak
+     during the phase, returning false if the budget has been exceeded */
+  bool checkpoint(const std::string& phase);
+  /* is the current memory use within the budget? */
+  bool withinBudget() const;
+  /* record some other quantity of interest */
+  void note(const std::string& what,long value);
+  /* print the report, to stderr if we went over budget */
+  void print() const;
+  bool exceeded() const
+  {
+    return mExceeded;
+  }
+private:
+  class Checkpoint
+  {
+  public:
+    std::string phase;
+    long current;
+    long peak;
+  };
+  long mBudget;
+  bool mActive;
+  bool mExceeded;
+  // can we measure the peak of each phase, rather than of the process?
+  bool mPhasePeaks;
+  std::vector<Checkpoint> mCheckpoints;
+  std::vector< std::pair<std::string,long> > mNotes;
+};
+
+#endif /* _MEMORY_HPP_ */
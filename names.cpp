@@ -0,0 +1,108 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <wchar.h>
+
+#include "names.hpp"
+
+std::wstring NameAllocator::allocate(const std::wstring& base)
+{
+  if (mUsed.insert(base).second) return base;
+  unsigned long& suffix = mNextSuffix[base];
+  wchar_t tmp[32];
+  std::wstring name;
+  do
+  {
+    swprintf(tmp,32,L"_%03lu",++suffix);
+    name = base + tmp;
+  } while (!mUsed.insert(name).second);
+  return name;
+}
+
+bool NamePool::Name::operator==(const Name& other) const
+{
+  return ((length == other.length) &&
+    (wmemcmp(text,other.text,length) == 0));
+}
+
+size_t NamePool::NameHash::operator()(const Name& name) const
+{
+  // FNV-1a over the characters
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i=0;i<name.length;++i)
+  {
+    hash ^= (uint64_t)name.text[i];
+    hash *= 1099511628211ULL;
+  }
+  return (size_t)hash;
+}
+
+NamePool::NamePool(Arena& arena) : mArena(arena),
+  mIds(0,NameHash(),std::equal_to<Name>(),arena), mSize(0),
+  mInitialValueNames(0,std::hash<NameId>(),std::equal_to<NameId>(),arena)
+{
+}
+
+NameId NamePool::intern(const std::wstring& name)
+{
+  Name key;
+  key.text = name.c_str();
+  key.length = name.size();
+  IdMap::const_iterator i = mIds.find(key);
+  if (i != mIds.end()) return i->second;
+  // keep a copy of the text in the arena
+  wchar_t* text = static_cast<wchar_t*>(mArena.allocate(
+      (key.length+1)*sizeof(wchar_t),alignof(wchar_t)));
+  wmemcpy(text,key.text,key.length+1);
+  key.text = text;
+  if ((mSize % NAME_BLOCK_SIZE) == 0)
+  {
+    mBlocks.push_back(static_cast<Name*>(mArena.allocate(
+        NAME_BLOCK_SIZE*sizeof(Name),alignof(Name))));
+  }
+  NameId id = (NameId)mSize++;
+  mBlocks.back()[id % NAME_BLOCK_SIZE] = key;
+  mIds[key] = id;
+  return id;
+}
+
+NameId NamePool::initialValueName(NameId id)
+{
+  NameIdMap::const_iterator i = mInitialValueNames.find(id);
+  if (i != mInitialValueNames.end()) return i->second;
+  NameId ivId = intern(std::wstring(name(id)) + INITIAL_VALUE_SUFFIX);
+  mInitialValueNames[id] = ivId;
+  return ivId;
+}
@@ -0,0 +1,148 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _NAMES_HPP_
+#define _NAMES_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+#include <inttypes.h>
+
+#include "arena.hpp"
+
+/* Hands out unique names, appending _001, _002, ... to a base name when it
+   has already been used. Each base name keeps its own counter so finding a
+   free name doesn't require probing all the previous suffixes, and there is
+   no limit on the number of suffixes. */
+class NameAllocator
+{
+public:
+  /* get a unique name based on the given name, which is then marked as
+     used */
+  std::wstring allocate(const std::wstring& base);
+  /* has the given name already been used? */
+  bool used(const std::wstring& name) const
+  {
+    return (mUsed.find(name) != mUsed.end());
+  }
+  /* forget all the names handed out so far */
+  void clear()
+  {
+    mUsed.clear();
+    mNextSuffix.clear();
+  }
+private:
+  std::unordered_set<std::wstring> mUsed;
+  std::unordered_map<std::wstring,unsigned long> mNextSuffix;
+};
+
+/* Component, variable and units names (and initial values) interned as
+   small integer IDs, so the variable index, the component plans and the
+   connection and interface tables can store and compare IDs rather than
+   copies of the names. The names themselves are only needed again when the
+   output documents are built. A pool lasts for one decomposition, with the
+   names and its tables kept in the decomposition's arena, and isn't thread
+   safe: names are only interned while building the index, planning the
+   components and applying the shared updates. */
+typedef uint32_t NameId;
+typedef std::pair<NameId,NameId> NameIdPair;
+/* no name at all, such as a missing initial value */
+#define NO_NAME ((NameId)-1)
+/* added to a state variable's name for the variable holding its initial
+   value */
+#define INITIAL_VALUE_SUFFIX L"_initial"
+
+#define NAME_BLOCK_SIZE 1024
+
+class NamePool
+{
+public:
+  NamePool(Arena& arena);
+  /* the ID of the given name, which is added to the pool if need be */
+  NameId intern(const std::wstring& name);
+  /* the ID of the name of the initial value variable for the named state
+     variable, which is only made the first time it is asked for */
+  NameId initialValueName(NameId id);
+  /* the text of the name, which lasts as long as the arena */
+  const wchar_t* name(NameId id) const
+  {
+    return mBlocks[id / NAME_BLOCK_SIZE][id % NAME_BLOCK_SIZE].text;
+  }
+  size_t size() const
+  {
+    return mSize;
+  }
+private:
+  /* the text of a name and its length */
+  class Name
+  {
+  public:
+    bool operator==(const Name& other) const;
+    const wchar_t* text;
+    size_t length;
+  };
+  class NameHash
+  {
+  public:
+    size_t operator()(const Name& name) const;
+  };
+  typedef std::unordered_map<Name,NameId,NameHash,std::equal_to<Name>,
+                             ArenaAllocator<std::pair<const Name,NameId> > >
+    IdMap;
+  typedef std::unordered_map<NameId,NameId,std::hash<NameId>,
+                             std::equal_to<NameId>,
+                             ArenaAllocator<std::pair<const NameId,
+                                                      NameId> > > NameIdMap;
+  NamePool(const NamePool&);
+  NamePool& operator=(const NamePool&);
+
+  Arena& mArena;
+  IdMap mIds;
+  // the names by ID, in blocks of NAME_BLOCK_SIZE
+  std::vector<Name*> mBlocks;
+  size_t mSize;
+  NameIdMap mInitialValueNames;
+};
+
+/* a pair of IDs as a single key for the unordered containers */
+inline uint64_t nameIdKey(NameId first,NameId second)
+{
+  return (((uint64_t)first) << 32) | second;
+}
+
+#endif /* _NAMES_HPP_ */
@@ -0,0 +1,127 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <stdlib.h>
+#include <wchar.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "namespaces.hpp"
+#include "profile.hpp"
+
+std::wstring translateNamespace(const std::wstring& ns)
+{
+  if (ns == CELLML_1_0_NS) return CELLML_1_1_NS;
+  return ns;
+}
+
+static iface::dom::Node* importElement(iface::dom::Document* doc,
+  iface::dom::Node* node)
+{
+  RETURN_INTO_WSTRING(qname,node->nodeName());
+  RETURN_INTO_WSTRING(ns,node->namespaceURI());
+  RETURN_INTO_OBJREF(element,iface::dom::Element,
+    doc->createElementNS(translateNamespace(ns).c_str(),qname.c_str()));
+  // copy the attributes
+  RETURN_INTO_OBJREF(attrs,iface::dom::NamedNodeMap,node->attributes());
+  uint32_t i,l = attrs ? attrs->length() : 0;
+  for (i=0;i<l;++i)
+  {
+    RETURN_INTO_OBJREF(attr,iface::dom::Node,attrs->item(i));
+    RETURN_INTO_WSTRING(aname,attr->nodeName());
+    RETURN_INTO_WSTRING(avalue,attr->nodeValue());
+    RETURN_INTO_WSTRING(ans,attr->namespaceURI());
+    if ((ans == XMLNS_NS) || (aname == L"xmlns") ||
+      (aname.compare(0,6,L"xmlns:") == 0))
+      element->setAttributeNS(XMLNS_NS,aname.c_str(),
+        translateNamespace(avalue).c_str());
+    else if (ans.empty())
+      element->setAttribute(aname.c_str(),avalue.c_str());
+    else
+      element->setAttributeNS(translateNamespace(ans).c_str(),aname.c_str(),
+        avalue.c_str());
+  }
+  // and the children
+  RETURN_INTO_OBJREF(child,iface::dom::Node,node->firstChild());
+  while (child)
+  {
+    RETURN_INTO_OBJREF(newChild,iface::dom::Node,
+      importNodeCellML11(doc,child));
+    if (newChild)
+    {
+      RETURN_INTO_OBJREF(appended,iface::dom::Node,
+        element->appendChild(newChild));
+    }
+    child = already_AddRefd<iface::dom::Node>(child->nextSibling());
+  }
+  element->add_ref();
+  return(element);
+}
+
+iface::dom::Node* importNodeCellML11(iface::dom::Document* doc,
+  iface::dom::Node* node)
+{
+  profileCount(PROFILE_IMPORT_NODE);
+  switch (node->nodeType())
+  {
+  case iface::dom::Node::ELEMENT_NODE:
+    return importElement(doc,node);
+  case iface::dom::Node::TEXT_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      return doc->createTextNode(text.c_str());
+    }
+  case iface::dom::Node::CDATA_SECTION_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      return doc->createCDATASection(text.c_str());
+    }
+  case iface::dom::Node::COMMENT_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      return doc->createComment(text.c_str());
+    }
+  case iface::dom::Node::PROCESSING_INSTRUCTION_NODE:
+    {
+      RETURN_INTO_WSTRING(target,node->nodeName());
+      RETURN_INTO_WSTRING(data,node->nodeValue());
+      return doc->createProcessingInstruction(target.c_str(),data.c_str());
+    }
+  default:
+    // anything else can go through the normal DOM import
+    return doc->importNode(node,/*deep*/true);
+  }
+}
@@ -0,0 +1,59 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _NAMESPACES_HPP_
+#define _NAMESPACES_HPP_
+
+#include <string>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#define CELLML_1_0_NS L"http://www.cellml.org/cellml/1.0#"
+#define CELLML_1_1_NS L"http://www.cellml.org/cellml/1.1#"
+#define MATHML_NS L"http://www.w3.org/1998/Math/MathML"
+#define XMLNS_NS L"http://www.w3.org/2000/xmlns/"
+
+/* map a CellML 1.0 namespace into CellML 1.1, anything else is unchanged */
+std::wstring translateNamespace(const std::wstring& ns);
+
+/* Make a deep copy of the given node (from a CellML 1.0 or 1.1 document) in
+   the given document, translating any CellML 1.0 namespaces on elements,
+   attributes and namespace declarations into CellML 1.1 as we go. Returns
+   the new node which is owned by the caller but not yet in the document
+   tree. */
+iface::dom::Node* importNodeCellML11(iface::dom::Document* doc,
+  iface::dom::Node* node);
+
+#endif /* _NAMESPACES_HPP_ */
@@ -0,0 +1,343 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "output.hpp"
+#include "parallel.hpp"
+#include "serialise.hpp"
+#include "profile.hpp"
+
+ReportLine::~ReportLine()
+{
+  static std::mutex reportMutex;
+  std::lock_guard<std::mutex> lock(reportMutex);
+  mOut << mLine.str() << std::endl;
+}
+
+bool DirectorySink::write(const std::string& name,const std::string& data)
+{
+  std::string file = mDir + "/" + name;
+  ReportLine() << "Writing to file: " << file;
+  FILE* f = fopen(file.c_str(),"wb");
+  if (f == NULL)
+  {
+    ReportLine(std::cerr) << "ERROR opening file for writing: " << file;
+    return false;
+  }
+  bool ok = (fwrite(data.data(),1,data.size(),f) == data.size());
+  profileCount(PROFILE_BYTES_WRITTEN,data.size());
+  if (fclose(f) != 0) ok = false;
+  if (!ok) ReportLine(std::cerr) << "ERROR writing file: " << file;
+  return ok;
+}
+
+bool MemorySink::begin(const std::vector<std::string>& names)
+{
+  mDocuments.clear();
+  mDocuments.reserve(names.size());
+  return true;
+}
+
+bool MemorySink::write(const std::string& name,const std::string& data)
+{
+  mDocuments.push_back(Document(name,data));
+  profileCount(PROFILE_BYTES_WRITTEN,data.size());
+  return true;
+}
+
+const std::string* MemorySink::find(const std::string& name) const
+{
+  std::vector<Document>::const_iterator i = mDocuments.begin();
+  for (;i!=mDocuments.end();++i) if (i->first == name) return &(i->second);
+  return NULL;
+}
+
+#define TAR_BLOCK 512
+
+TarSink::TarSink(const std::string& file) :
+  mFile(file), mOut(NULL), mOffset(0), mIndexOffset(0), mIndexSize(0)
+{
+}
+
+TarSink::~TarSink()
+{
+  if (mOut) fclose(mOut);
+}
+
+bool TarSink::writeData(const char* data,size_t size)
+{
+  static const char zeros[TAR_BLOCK] = {0};
+  if (fwrite(data,1,size,mOut) != size) return false;
+  size_t pad = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+  if (fwrite(zeros,1,pad,mOut) != pad) return false;
+  mOffset += size + pad;
+  return true;
+}
+
+bool TarSink::writeHeader(const std::string& name,size_t size,char type)
+{
+  if (name.size() >= 100)
+  {
+    // use a GNU long name entry for names which don't fit in the header
+    if (!writeHeader("././@LongLink",name.size()+1,'L')) return false;
+    if (!writeData(name.c_str(),name.size()+1)) return false;
+  }
+  char header[TAR_BLOCK];
+  memset(header,0,TAR_BLOCK);
+  strncpy(header,name.c_str(),99);
+  sprintf(header+100,"%07o",0644);
+  sprintf(header+108,"%07o",0);
+  sprintf(header+116,"%07o",0);
+  sprintf(header+124,"%011lo",(unsigned long)size);
+  sprintf(header+136,"%011lo",(unsigned long)time(NULL));
+  header[156] = type;
+  memcpy(header+257,"ustar",6);
+  memcpy(header+263,"00",2);
+  // the checksum is calculated with the checksum field full of spaces
+  memset(header+148,' ',8);
+  unsigned int sum = 0;
+  for (int i=0;i<TAR_BLOCK;++i) sum += (unsigned char)header[i];
+  sprintf(header+148,"%06o",sum);
+  return writeData(header,TAR_BLOCK);
+}
+
+bool TarSink::begin(const std::vector<std::string>& names)
+{
+  mOut = fopen(mFile.c_str(),"wb");
+  if (mOut == NULL)
+  {
+    ReportLine(std::cerr) << "ERROR opening archive for writing: " << mFile;
+    return false;
+  }
+  ReportLine() << "Writing to archive: " << mFile;
+  /* each index line has a fixed width for a given name, so we can reserve
+     the space for the index now and fill it in once we know where all the
+     documents have ended up */
+  mIndexSize = 0;
+  for (size_t i=0;i<names.size();++i) mIndexSize += 26 + names[i].size() + 1;
+  if (!writeHeader(ARCHIVE_INDEX_NAME,mIndexSize,'0')) return false;
+  mIndexOffset = mOffset;
+  return writeData(std::string(mIndexSize,'\n').c_str(),mIndexSize);
+}
+
+bool TarSink::write(const std::string& name,const std::string& data)
+{
+  if (mOut == NULL) return false;
+  ReportLine() << "Writing to archive member: " << name;
+  if (!writeHeader(name,data.size(),'0')) return false;
+  Member m;
+  m.name = name;
+  m.offset = mOffset;
+  m.size = data.size();
+  if (!writeData(data.data(),data.size())) return false;
+  profileCount(PROFILE_BYTES_WRITTEN,data.size());
+  mMembers.push_back(m);
+  return true;
+}
+
+bool TarSink::finish()
+{
+  if (mOut == NULL) return false;
+  // the end of archive marker is two empty blocks
+  static const char zeros[2*TAR_BLOCK] = {0};
+  bool ok = (fwrite(zeros,1,2*TAR_BLOCK,mOut) == 2*TAR_BLOCK);
+  // now go back and fill in the index
+  std::string index;
+  char line[32];
+  for (size_t i=0;i<mMembers.size();++i)
+  {
+    sprintf(line,"%012lu %012lu ",(unsigned long)mMembers[i].offset,
+      (unsigned long)mMembers[i].size);
+    index += line + mMembers[i].name + "\n";
+  }
+  if (index.size() != mIndexSize)
+  {
+    // the documents written don't match those we were told about
+    ReportLine(std::cerr) << "ERROR archive index does not match its members: "
+                          << mFile;
+    ok = false;
+  }
+  else if (fseek(mOut,mIndexOffset,SEEK_SET) != 0 ||
+    fwrite(index.data(),1,index.size(),mOut) != index.size()) ok = false;
+  if (fclose(mOut) != 0) ok = false;
+  mOut = NULL;
+  if (!ok) ReportLine(std::cerr) << "ERROR writing archive: " << mFile;
+  return ok;
+}
+
+OutputPipeline::OutputPipeline(OutputSink& sink,int jobs) :
+  mSink(sink), mFirst(0), mNextToSerialise(0), mSubmitted(0),
+  mFinishing(false), mFinished(false), mOK(true), mSerialisedBytes(0),
+  mLargestDocument(0), mPendingBytes(0), mPeakPendingBytes(0)
+{
+  unsigned int n = effectiveJobs(jobs);
+  // allow a couple of documents per serialiser to be waiting on the writer
+  mCapacity = 2*n + 1;
+  for (unsigned int i=0;i<n;++i)
+    mThreads.push_back(std::thread(&OutputPipeline::serialiser,this));
+  mThreads.push_back(std::thread(&OutputPipeline::writer,this));
+}
+
+OutputPipeline::~OutputPipeline()
+{
+  // if we weren't finished properly, just stop without finishing the sink
+  stop();
+}
+
+void OutputPipeline::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFinishing = true;
+    mCond.notify_all();
+  }
+  for (size_t i=0;i<mThreads.size();++i) mThreads[i].join();
+  mThreads.clear();
+}
+
+void OutputPipeline::submit(const std::string& name,
+  ObjRef<iface::cellml_api::Model> model)
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (mJobs.size() >= mCapacity) mCond.wait(lock);
+  mJobs.push_back(Job());
+  Job& job = mJobs.back();
+  job.name = name;
+  job.model = std::move(model);
+  job.ready = false;
+  job.ok = false;
+  job.keep = false;
+  mSubmitted++;
+  mCond.notify_all();
+}
+
+void OutputPipeline::keep(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (mJobs.size() >= mCapacity) mCond.wait(lock);
+  mJobs.push_back(Job());
+  Job& job = mJobs.back();
+  job.name = name;
+  // nothing to serialise, so it is ready to go straight to the sink
+  job.ready = true;
+  job.ok = true;
+  job.keep = true;
+  mSubmitted++;
+  mCond.notify_all();
+}
+
+bool OutputPipeline::finish()
+{
+  if (mFinished) return mOK;
+  stop();
+  mFinished = true;
+  if (!mSink.finish()) mOK = false;
+  // report the final list of documents, as each was reported when written
+  ReportLine report;
+  report << "Documents written: " << mWritten.size();
+  std::vector<std::string>::const_iterator i = mWritten.begin();
+  for (;i!=mWritten.end();++i) report << "\n  " << *i;
+  return mOK;
+}
+
+void OutputPipeline::serialiser()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (true)
+  {
+    // kept documents may have gone straight to the writer
+    if (mNextToSerialise < mFirst) mNextToSerialise = mFirst;
+    if (mNextToSerialise < mSubmitted)
+    {
+      // references to deque elements stay valid as jobs are added and
+      // removed at the ends
+      Job& job = mJobs[mNextToSerialise - mFirst];
+      mNextToSerialise++;
+      if (job.keep) continue;
+      lock.unlock();
+      ProfileScope profile(job.name.c_str(),"document");
+      bool ok = serialiseModelToString(job.model,job.data);
+      if (!ok)
+        ReportLine(std::cerr) << "ERROR serialising document: " << job.name;
+      // we don't need the model any more
+      job.model = NULL;
+      lock.lock();
+      job.ok = ok;
+      job.ready = true;
+      size_t size = job.data.size();
+      mSerialisedBytes += size;
+      if (size > mLargestDocument) mLargestDocument = size;
+      mPendingBytes += size;
+      if (mPendingBytes > mPeakPendingBytes)
+        mPeakPendingBytes = mPendingBytes;
+      mCond.notify_all();
+    }
+    else if (mFinishing) break;
+    else mCond.wait(lock);
+  }
+}
+
+void OutputPipeline::writer()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (true)
+  {
+    if (!mJobs.empty() && mJobs.front().ready)
+    {
+      // the serialisers are finished with the front job
+      Job& job = mJobs.front();
+      lock.unlock();
+      bool ok = job.ok && (job.keep ? mSink.keep(job.name) :
+        mSink.write(job.name,job.data));
+      lock.lock();
+      if (ok) mWritten.push_back(job.name);
+      else mOK = false;
+      mPendingBytes -= job.data.size();
+      mJobs.pop_front();
+      mFirst++;
+      mCond.notify_all();
+    }
+    else if (mFinishing && mJobs.empty()) break;
+    else mCond.wait(lock);
+  }
+}
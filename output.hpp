@@ -0,0 +1,254 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _OUTPUT_HPP_
+#define _OUTPUT_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <sstream>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+
+/* A line of progress for stdout, or an error for stderr, which is written
+   out whole when it goes out of scope. The sinks are written to from the
+   output pipeline's writer thread, so all their messages (and those of
+   anything running alongside them) go through the one lock to keep lines
+   from different threads apart. */
+class ReportLine
+{
+public:
+  ReportLine(std::ostream& out = std::cout) : mOut(out)
+  {
+  }
+  ~ReportLine();
+  template<class T> ReportLine& operator<<(const T& value)
+  {
+    mLine << value;
+    return *this;
+  }
+private:
+  std::ostream& mOut;
+  std::ostringstream mLine;
+};
+
+/* Somewhere to put the serialised output documents */
+class OutputSink
+{
+public:
+  virtual ~OutputSink()
+  {
+  }
+  /* called with the names of all the documents before any are written */
+  virtual bool begin(const std::vector<std::string>& names)
+  {
+    return true;
+  }
+  /* write the given document, returning false on error */
+  virtual bool write(const std::string& name,const std::string& data) = 0;
+  /* keep the named document from a previous run as it is, returning false
+     if that isn't possible */
+  virtual bool keep(const std::string& name)
+  {
+    return false;
+  }
+  /* called once all the documents have been written */
+  virtual bool finish()
+  {
+    return true;
+  }
+};
+
+/* Writes each document to its own file in a directory */
+class DirectorySink : public OutputSink
+{
+public:
+  DirectorySink(const std::string& dir) : mDir(dir)
+  {
+  }
+  virtual bool write(const std::string& name,const std::string& data);
+private:
+  std::string mDir;
+};
+
+/* Keeps all the documents in memory, in the order they were written, for
+   callers of the library which don't want them on disk at all */
+class MemorySink : public OutputSink
+{
+public:
+  typedef std::pair<std::string,std::string> Document;
+  virtual bool begin(const std::vector<std::string>& names);
+  virtual bool write(const std::string& name,const std::string& data);
+  /* the names and serialised content of the documents written */
+  const std::vector<Document>& documents() const
+  {
+    return mDocuments;
+  }
+  /* the content of the named document, or NULL if it wasn't written */
+  const std::string* find(const std::string& name) const;
+private:
+  std::vector<Document> mDocuments;
+};
+
+/* Writes all the documents into a single (ustar) tar archive. The first
+   member of the archive is an index, named by ARCHIVE_INDEX_NAME, with a
+   line for each document giving the offset of the document's data from the
+   start of the archive and its size, both as 12 digit decimal numbers,
+   followed by its name:
+
+     000000001536 000000004321 model_interface_model.xml
+
+   so a consumer can map the archive and go straight to any document. The
+   documents are all stored at the top level of the archive so the relative
+   imports between them still resolve. */
+#define ARCHIVE_INDEX_NAME "index.txt"
+
+class TarSink : public OutputSink
+{
+public:
+  TarSink(const std::string& file);
+  virtual ~TarSink();
+  virtual bool begin(const std::vector<std::string>& names);
+  virtual bool write(const std::string& name,const std::string& data);
+  virtual bool finish();
+private:
+  bool writeHeader(const std::string& name,size_t size,char type);
+  bool writeData(const char* data,size_t size);
+  class Member
+  {
+  public:
+    std::string name;
+    size_t offset;
+    size_t size;
+  };
+  std::string mFile;
+  FILE* mOut;
+  size_t mOffset;
+  size_t mIndexOffset;
+  size_t mIndexSize;
+  std::vector<Member> mMembers;
+};
+
+/* An output pipeline which serialises the submitted models on a number of
+   worker threads while a single writer thread passes the serialised
+   documents on to the sink, in the order they were submitted. The number of
+   documents in flight is bounded, so submit() will block if the writer gets
+   too far behind. */
+class OutputPipeline
+{
+public:
+  OutputPipeline(OutputSink& sink,int jobs);
+  ~OutputPipeline();
+  /* tell the sink the names of all the documents about to be submitted */
+  bool begin(const std::vector<std::string>& names)
+  {
+    return mSink.begin(names);
+  }
+  /* queue the given model to be serialised to the named document, taking
+     over the given reference to it */
+  void submit(const std::string& name,
+    ObjRef<iface::cellml_api::Model> model);
+  /* keep the named document from a previous run, in order with the
+     submitted documents */
+  void keep(const std::string& name);
+  /* wait for all the submitted documents to be written, reporting the list
+     of those written and returning false if any of them failed */
+  bool finish();
+  /* the documents successfully written so far */
+  const std::vector<std::string>& written() const
+  {
+    return mWritten;
+  }
+  /* the total size of the serialised documents, the size of the largest
+     one and the most serialised data waiting to be written at once */
+  size_t serialisedBytes() const
+  {
+    return mSerialisedBytes;
+  }
+  size_t largestDocument() const
+  {
+    return mLargestDocument;
+  }
+  size_t peakPendingBytes() const
+  {
+    return mPeakPendingBytes;
+  }
+private:
+  class Job
+  {
+  public:
+    std::string name;
+    ObjRef<iface::cellml_api::Model> model;
+    std::string data;
+    bool ready;
+    bool ok;
+    bool keep;
+  };
+  void serialiser();
+  void writer();
+  void stop();
+  OutputPipeline(const OutputPipeline&);
+  OutputPipeline& operator=(const OutputPipeline&);
+
+  OutputSink& mSink;
+  size_t mCapacity;
+  std::deque<Job> mJobs;
+  // the sequence numbers of the first job in the queue, the next job to be
+  // serialised and the next job to be submitted
+  size_t mFirst;
+  size_t mNextToSerialise;
+  size_t mSubmitted;
+  bool mFinishing;
+  bool mFinished;
+  bool mOK;
+  std::vector<std::string> mWritten;
+  size_t mSerialisedBytes;
+  size_t mLargestDocument;
+  size_t mPendingBytes;
+  size_t mPeakPendingBytes;
+  std::mutex mMutex;
+  std::condition_variable mCond;
+  std::vector<std::thread> mThreads;
+};
+
+#endif /* _OUTPUT_HPP_ */
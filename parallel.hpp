@@ -0,0 +1,99 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _PARALLEL_HPP_
+#define _PARALLEL_HPP_
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work out how many worker threads to use for the requested number of jobs,
+   with zero (or less) meaning use all the available hardware threads */
+inline unsigned int effectiveJobs(int jobs)
+{
+  if (jobs > 0) return (unsigned int)jobs;
+  unsigned int n = std::thread::hardware_concurrency();
+  return (n > 0) ? n : 1;
+}
+
+/* Call the given function for each index in [0,count) using up to the given
+   number of threads (the calling thread is one of them). Indices are handed
+   out in order, but may complete in any order. If any call throws then the
+   first exception caught is rethrown in the calling thread once all the
+   threads have finished. */
+inline void parallelFor(size_t count,int jobs,
+  const std::function<void(size_t)>& f)
+{
+  unsigned int nThreads = effectiveJobs(jobs);
+  if (nThreads > count) nThreads = (unsigned int)count;
+  if (nThreads <= 1)
+  {
+    for (size_t i=0;i<count;++i) f(i);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto worker = [&]()
+  {
+    while (!failed)
+    {
+      size_t i = next++;
+      if (i >= count) break;
+      try
+      {
+        f(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) error = std::current_exception();
+        failed = true;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int t=1;t<nThreads;++t) threads.push_back(std::thread(worker));
+  worker();
+  for (size_t t=0;t<threads.size();++t) threads[t].join();
+  if (error) std::rethrow_exception(error);
+}
+
+#endif /* _PARALLEL_HPP_ */
@@ -0,0 +1,317 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.hpp"
+#include "memory.hpp"
+#include "strings.hpp"
+#include "version.hpp"
+
+/* A single timed event */
+class ProfileEvent
+{
+public:
+  std::string name;
+  const char* category;
+  int thread;
+  // all times in microseconds, starts from when profiling was enabled
+  double start;
+  double wall;
+  double cpu;
+  // the peak resident set size at the end of a phase, in kB
+  long rss;
+};
+
+/* the totals for a named event */
+class ProfileTotal
+{
+public:
+  ProfileTotal() : count(0), wall(0.0), cpu(0.0), rss(0)
+  {
+  }
+  int count;
+  double wall;
+  double cpu;
+  long rss;
+};
+
+/* the totals for all the events in a category, by name in the order they
+   first happened */
+class ProfileTotals
+{
+public:
+  std::vector<std::string> order;
+  std::map<std::string,ProfileTotal> totals;
+};
+
+static bool gEnabled = false;
+static bool gTiming = false;
+static bool gTrace = false;
+static std::chrono::steady_clock::time_point gEpoch;
+static std::atomic<long> gCounters[PROFILE_COUNTERS];
+static std::mutex gMutex;
+static std::map<std::string,ProfileTotals> gTotals;
+static std::vector<ProfileEvent> gEvents;
+static long gDroppedEvents = 0;
+static std::map<std::thread::id,int> gThreads;
+
+static const char* gCounterNames[PROFILE_COUNTERS] =
+{
+  "findVariableSet",
+  "importNode",
+  "storeConnection",
+  "connections",
+  "mappings",
+  "bytesWritten",
+  "importsRead",
+  "importsCached",
+  "variablesPruned"
+};
+
+/* the categories of events totalled in the report */
+#define REPORT_CATEGORIES 3
+static const char* gReportCategories[REPORT_CATEGORIES] =
+{
+  "phase",
+  "component",
+  "document"
+};
+
+static bool isReported(const char* category)
+{
+  for (int i=0;i<REPORT_CATEGORIES;++i)
+  {
+    if (strcmp(category,gReportCategories[i]) == 0) return true;
+  }
+  return false;
+}
+
+static double wallTime()
+{
+  return std::chrono::duration<double,std::micro>(
+    std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+static double cpuTime(bool process)
+{
+  struct timespec ts;
+  clock_gettime(process ? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID,
+    &ts);
+  return ts.tv_sec*1.0e6 + ts.tv_nsec*1.0e-3;
+}
+
+void profileEnable(bool timing,bool trace)
+{
+  gEpoch = std::chrono::steady_clock::now();
+  for (int i=0;i<PROFILE_COUNTERS;++i) gCounters[i] = 0;
+  gTiming = timing || trace;
+  gTrace = trace;
+  gEnabled = true;
+}
+
+bool profileEnabled()
+{
+  return gEnabled;
+}
+
+void profileCount(ProfileCounter counter,long n)
+{
+  if (gEnabled) gCounters[counter] += n;
+}
+
+long profileCounter(ProfileCounter counter)
+{
+  return gCounters[counter];
+}
+
+ProfileScope::ProfileScope(const char* name,const char* category) :
+  mActive(gTiming), mCategory(category)
+{
+  if (!mActive) return;
+  mName = name;
+  start();
+}
+
+ProfileScope::ProfileScope(const std::wstring& name,const char* category) :
+  mActive(gTiming), mCategory(category)
+{
+  if (!mActive) return;
+  mName = narrow(name);
+  start();
+}
+
+void ProfileScope::start()
+{
+  mProcess = (std::string(mCategory) == "phase");
+  mWallStart = wallTime();
+  mCPUStart = cpuTime(mProcess);
+}
+
+ProfileScope::~ProfileScope()
+{
+  if (!mActive) return;
+  ProfileEvent e;
+  e.wall = wallTime() - mWallStart;
+  e.cpu = cpuTime(mProcess) - mCPUStart;
+  e.name = mName;
+  e.category = mCategory;
+  e.start = mWallStart;
+  e.rss = mProcess ? memoryPeak() : 0;
+  std::lock_guard<std::mutex> lock(gMutex);
+  // the report only needs the totals, which are kept as we go
+  if (isReported(mCategory))
+  {
+    ProfileTotals& totals = gTotals[mCategory];
+    std::map<std::string,ProfileTotal>::iterator i =
+      totals.totals.find(mName);
+    if (i == totals.totals.end())
+    {
+      totals.order.push_back(mName);
+      i = totals.totals.insert(std::make_pair(mName,ProfileTotal())).first;
+    }
+    ProfileTotal& total = i->second;
+    total.count++;
+    total.wall += e.wall;
+    total.cpu += e.cpu;
+    if (e.rss > total.rss) total.rss = e.rss;
+  }
+  if (!gTrace) return;
+  if (gEvents.size() >= PROFILE_TRACE_LIMIT)
+  {
+    gDroppedEvents++;
+    return;
+  }
+  std::thread::id id = std::this_thread::get_id();
+  std::map<std::thread::id,int>::const_iterator t = gThreads.find(id);
+  if (t == gThreads.end())
+  {
+    e.thread = (int)gThreads.size() + 1;
+    gThreads[id] = e.thread;
+  }
+  else e.thread = t->second;
+  gEvents.push_back(e);
+}
+
+/* quote a string for JSON */
+static std::string quote(const std::string& str)
+{
+  std::string q = "\"";
+  for (size_t i=0;i<str.size();++i)
+  {
+    char c = str[i];
+    if ((c == '"') || (c == '\\')) q += '\\';
+    if ((unsigned char)c < 0x20)
+    {
+      char tmp[8];
+      sprintf(tmp,"\\u%04x",c);
+      q += tmp;
+    }
+    else q += c;
+  }
+  return q + "\"";
+}
+
+static void writeTotals(FILE* f,const char* category)
+{
+  ProfileTotals& totals = gTotals[category];
+  const std::vector<std::string>& order = totals.order;
+  fprintf(f,"  \"%ss\": [",category);
+  for (size_t i=0;i<order.size();++i)
+  {
+    const ProfileTotal& t = totals.totals[order[i]];
+    fprintf(f,"%s\n    {\"name\": %s, \"count\": %d, \"wall_ms\": %.3f, "
+      "\"cpu_ms\": %.3f",(i ? "," : ""),quote(order[i]).c_str(),t.count,
+      t.wall/1000.0,t.cpu/1000.0);
+    if (t.rss) fprintf(f,", \"peak_rss_kb\": %ld",t.rss);
+    fprintf(f,"}");
+  }
+  fprintf(f,"\n  ],\n");
+}
+
+bool profileWriteReport(const std::string& file)
+{
+  FILE* f = fopen(file.c_str(),"w");
+  if (f == NULL) return false;
+  std::lock_guard<std::mutex> lock(gMutex);
+  fprintf(f,"{\n  \"version\": %s,\n",quote(getVersion()).c_str());
+  for (int i=0;i<REPORT_CATEGORIES;++i) writeTotals(f,gReportCategories[i]);
+  fprintf(f,"  \"counters\": {");
+  for (int i=0;i<PROFILE_COUNTERS;++i)
+  {
+    fprintf(f,"%s\n    \"%s\": %ld",(i ? "," : ""),gCounterNames[i],
+      (long)gCounters[i]);
+  }
+  fprintf(f,"\n  }\n}\n");
+  return (fclose(f) == 0);
+}
+
+bool profileWriteTrace(const std::string& file)
+{
+  FILE* f = fopen(file.c_str(),"w");
+  if (f == NULL) return false;
+  std::lock_guard<std::mutex> lock(gMutex);
+  fprintf(f,"{\"traceEvents\": [");
+  std::vector<ProfileEvent>::const_iterator e = gEvents.begin();
+  double end = 0.0;
+  for (;e!=gEvents.end();++e)
+  {
+    fprintf(f,"%s\n  {\"name\": %s, \"cat\": \"%s\", \"ph\": \"X\", "
+      "\"ts\": %.1f, \"dur\": %.1f, \"pid\": 1, \"tid\": %d, "
+      "\"args\": {\"cpu_us\": %.1f, \"peak_rss_kb\": %ld}}",
+      (e==gEvents.begin() ? "" : ","),quote(e->name).c_str(),e->category,
+      e->start,e->wall,e->thread,e->cpu,e->rss);
+    if (e->start + e->wall > end) end = e->start + e->wall;
+  }
+  // and the final counter values
+  fprintf(f,"%s\n  {\"name\": \"counters\", \"ph\": \"C\", \"ts\": %.1f, "
+    "\"pid\": 1, \"args\": {",(gEvents.empty() ? "" : ","),end);
+  for (int i=0;i<PROFILE_COUNTERS;++i)
+  {
+    fprintf(f,"%s\"%s\": %ld",(i ? ", " : ""),gCounterNames[i],
+      (long)gCounters[i]);
+  }
+  // and how many events didn't fit in the trace
+  fprintf(f,", \"droppedEvents\": %ld}}\n]}\n",gDroppedEvents);
+  return (fclose(f) == 0);
+}
@@ -0,0 +1,109 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _PROFILE_HPP_
+#define _PROFILE_HPP_
+
+#include <string>
+
+/* The things we count while profiling */
+enum ProfileCounter
+{
+  // calls to CeVAS findVariableSet
+  PROFILE_FIND_VARIABLE_SET,
+  // DOM nodes imported into the new documents
+  PROFILE_IMPORT_NODE,
+  // variable connections stored in the connection graph
+  PROFILE_STORE_CONNECTION,
+  // connections and variable mappings created in the interface model
+  PROFILE_CONNECTIONS,
+  PROFILE_MAPPINGS,
+  // bytes of serialised documents written out
+  PROFILE_BYTES_WRITTEN,
+  // imported documents read from disk and found in the import loader cache
+  PROFILE_IMPORTS_READ,
+  PROFILE_IMPORTS_CACHED,
+  // variables left out of the component models as unused
+  PROFILE_PRUNED,
+  PROFILE_COUNTERS
+};
+
+/* Turn on profiling, nothing is recorded until this is called. The counters
+   are always kept, the timed events are only totalled for the report if
+   timing is on, and are only kept one by one for the trace (up to
+   PROFILE_TRACE_LIMIT of them, so a long running server doesn't keep
+   growing) if trace is on. */
+#define PROFILE_TRACE_LIMIT 100000
+void profileEnable(bool timing,bool trace);
+bool profileEnabled();
+
+/* Add to one of the counters */
+void profileCount(ProfileCounter counter,long n = 1);
+/* The current value of one of the counters */
+long profileCounter(ProfileCounter counter);
+
+/* Records the wall and CPU time between its construction and destruction
+   as an event in the given category. Phases record the CPU time of the
+   whole process, so include any worker threads, everything else records
+   the CPU time of the current thread. Phases also record the peak resident
+   set size at their end. Cheap when profiling is off. */
+class ProfileScope
+{
+public:
+  ProfileScope(const char* name,const char* category = "phase");
+  ProfileScope(const std::wstring& name,const char* category);
+  ~ProfileScope();
+private:
+  void start();
+  ProfileScope(const ProfileScope&);
+  ProfileScope& operator=(const ProfileScope&);
+
+  bool mActive;
+  std::string mName;
+  const char* mCategory;
+  bool mProcess;
+  double mWallStart;
+  double mCPUStart;
+};
+
+/* Write out the profile as a JSON report, with the total time for each
+   phase, the time for each component and the counters */
+bool profileWriteReport(const std::string& file);
+
+/* Write out all the recorded events in the Chrome trace event format, for
+   viewing as a timeline */
+bool profileWriteTrace(const std::string& file);
+
+#endif /* _PROFILE_HPP_ */
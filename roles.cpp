@@ -0,0 +1,250 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <stdlib.h>
+#include <wchar.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCeVAS.hxx>
+
+#include "utils.hxx"
+#include "roles.hpp"
+#include "profile.hpp"
+
+VariableRoleIndex::VariableRoleIndex(NamePool& names) : mNames(names)
+{
+}
+
+VariableRoleIndex::~VariableRoleIndex()
+{
+}
+
+void VariableRoleIndex::build(iface::cellml_services::CeVAS* cevas,
+  const VariableList& stateVariables,const VariableList& boundVariables)
+{
+  std::vector< ObjRef<iface::cellml_api::CellMLComponent> > components;
+  RETURN_INTO_OBJREF(ci,iface::cellml_api::CellMLComponentIterator,
+    cevas->iterateRelevantComponents());
+  while (true)
+  {
+    RETURN_INTO_OBJREF(c,iface::cellml_api::CellMLComponent,
+      ci->nextComponent());
+    if (c == NULL) break;
+    components.push_back(std::move(c));
+  }
+  addComponents(components,stateVariables,boundVariables);
+  // grab the connected variables for all the source variables
+  VariableMap::iterator vi = mVariables.begin();
+  for (;vi!=mVariables.end();++vi)
+  {
+    VariableInfo& info = vi->second;
+    if (info.sourceInfo != &info) continue;
+    RETURN_INTO_OBJREF(cvs,iface::cellml_services::ConnectedVariableSet,
+      cevas->findVariableSet(info.variable));
+    profileCount(PROFILE_FIND_VARIABLE_SET);
+    int i,l=(int)cvs->length();
+    for (i=0;i<l;++i)
+    {
+      RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+        cvs->getVariable(i));
+      const VariableInfo* cv = find(v);
+      if (cv)
+        info.connected.push_back(VariableId(cv->componentId,cv->nameId));
+      else
+      {
+        RETURN_INTO_WSTRING(name,v->name());
+        RETURN_INTO_WSTRING(cname,v->componentName());
+        info.connected.push_back(VariableId(mNames.intern(cname),
+            mNames.intern(name)));
+      }
+    }
+  }
+}
+
+void VariableRoleIndex::build(
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+  components,const VariableList& stateVariables,
+  const VariableList& boundVariables,
+  const std::vector<VariableNameList>& connectedSets)
+{
+  addComponents(components,stateVariables,boundVariables);
+  std::vector<VariableNameList>::const_iterator s = connectedSets.begin();
+  for (;s!=connectedSets.end();++s)
+  {
+    VariableIdList set;
+    VariableNameList::const_iterator n = s->begin();
+    for (;n!=s->end();++n)
+      set.push_back(VariableId(mNames.intern(n->first),
+          mNames.intern(n->second)));
+    VariableIdList::const_iterator id = set.begin();
+    for (;id!=set.end();++id)
+    {
+      std::unordered_map<uint64_t,VariableInfo*>::iterator i =
+        mIds.find(nameIdKey(id->first,id->second));
+      if ((i != mIds.end()) && (i->second->sourceInfo == i->second))
+        i->second->connected = set;
+    }
+  }
+}
+
+void VariableRoleIndex::addComponents(
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+  components,const VariableList& stateVariables,
+  const VariableList& boundVariables)
+{
+  VariableList::const_iterator i = stateVariables.begin();
+  for (;i!=stateVariables.end();++i) mState.insert(*i);
+  for (i=boundVariables.begin();i!=boundVariables.end();++i)
+    mBound.insert(*i);
+  mComponents = components;
+  std::vector< ObjRef<iface::cellml_api::CellMLComponent> >::const_iterator
+    ci = mComponents.begin();
+  for (;ci!=mComponents.end();++ci)
+  {
+    iface::cellml_api::CellMLComponent* c = *ci;
+    VariableInfoList& list = mComponentVariables[c];
+    RETURN_INTO_OBJREF(vs,iface::cellml_api::CellMLVariableSet,
+      c->variables());
+    RETURN_INTO_OBJREF(vsi,iface::cellml_api::CellMLVariableIterator,
+      vs->iterateVariables());
+    while (true)
+    {
+      RETURN_INTO_OBJREF(v,iface::cellml_api::CellMLVariable,
+        vsi->nextVariable());
+      if (v == NULL) break;
+      list.push_back(addVariable(v,c));
+    }
+  }
+  /* make sure all the source variables are indexed, they should be unless
+     they live in a component CeVAS didn't think was relevant */
+  VariableList missing;
+  VariableMap::const_iterator vi = mVariables.begin();
+  for (;vi!=mVariables.end();++vi)
+  {
+    if (mVariables.find(vi->second.source) == mVariables.end())
+      missing.push_back(vi->second.source);
+  }
+  for (i=missing.begin();i!=missing.end();++i)
+  {
+    if (mVariables.find(*i) == mVariables.end()) addVariable(*i,NULL);
+  }
+  // and link up the source entries
+  VariableMap::iterator vj = mVariables.begin();
+  for (;vj!=mVariables.end();++vj)
+    vj->second.sourceInfo = &(mVariables.find(vj->second.source)->second);
+}
+
+VariableInfo*
+VariableRoleIndex::addVariable(iface::cellml_api::CellMLVariable* v,
+  iface::cellml_api::CellMLComponent* c)
+{
+  VariableInfo& info = mVariables[v];
+  info.variable = v;
+  info.source = already_AddRefd<iface::cellml_api::CellMLVariable>(
+    v->sourceVariable());
+  if (info.source == NULL) info.source = v;
+  info.sourceInfo = NULL;
+  RETURN_INTO_WSTRING(name,v->name());
+  RETURN_INTO_WSTRING(cname,v->componentName());
+  RETURN_INTO_WSTRING(unitsName,v->unitsName());
+  RETURN_INTO_WSTRING(initialValue,v->initialValue());
+  info.publicInterface = v->publicInterface();
+  info.privateInterface = v->privateInterface();
+  info.nameId = mNames.intern(name);
+  info.componentId = mNames.intern(cname);
+  info.unitsId = mNames.intern(unitsName);
+  info.initialValueId = initialValue.empty() ? NO_NAME :
+    mNames.intern(initialValue);
+  info.localUnits = false;
+  mIds[nameIdKey(info.componentId,info.nameId)] = &info;
+  if (c)
+  {
+    RETURN_INTO_OBJREF(unitsSet,iface::cellml_api::UnitsSet,c->units());
+    RETURN_INTO_OBJREF(units,iface::cellml_api::Units,
+      unitsSet->getUnits(unitsName.c_str()));
+    info.localUnits = (units != NULL);
+  }
+  if ((mBound.find(v) != mBound.end()) ||
+    (mBound.find(info.source) != mBound.end()))
+    info.role = ROLE_BOUND;
+  else if (info.source != v) info.role = ROLE_IMPORTED;
+  else if (info.initialValueId == NO_NAME) info.role = ROLE_COMPUTED;
+  else if (mState.find(v) != mState.end()) info.role = ROLE_STATE;
+  else info.role = ROLE_PARAMETER;
+  return(&info);
+}
+
+const VariableInfo*
+VariableRoleIndex::find(iface::cellml_api::CellMLVariable* v) const
+{
+  VariableMap::const_iterator i = mVariables.find(v);
+  if (i == mVariables.end()) return NULL;
+  return(&(i->second));
+}
+
+const VariableInfo* VariableRoleIndex::find(const VariableId& id) const
+{
+  std::unordered_map<uint64_t,VariableInfo*>::const_iterator i =
+    mIds.find(nameIdKey(id.first,id.second));
+  if (i == mIds.end()) return NULL;
+  return(i->second);
+}
+
+void VariableRoleIndex::connectedSets(std::vector<VariableNameList>& sets)
+  const
+{
+  VariableMap::const_iterator i = mVariables.begin();
+  for (;i!=mVariables.end();++i)
+  {
+    const VariableIdList& connected = i->second.connected;
+    if (connected.empty()) continue;
+    sets.push_back(VariableNameList());
+    VariableIdList::const_iterator id = connected.begin();
+    for (;id!=connected.end();++id)
+    {
+      sets.back().push_back(VariableName(mNames.name(id->first),
+          mNames.name(id->second)));
+    }
+  }
+}
+
+const VariableInfoList&
+VariableRoleIndex::componentVariables(iface::cellml_api::CellMLComponent* c)
+  const
+{
+  ComponentMap::const_iterator i = mComponentVariables.find(c);
+  if (i == mComponentVariables.end()) return mEmpty;
+  return(i->second);
+}
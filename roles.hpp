@@ -0,0 +1,168 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _ROLES_HPP_
+#define _ROLES_HPP_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <utility>
+
+#include <IfaceCellML_APISPEC.hxx>
+#include <IfaceCeVAS.hxx>
+
+#include "decompose.hpp"
+#include "names.hpp"
+
+/* The role a variable plays in the source model */
+enum VariableRole
+{
+  // a variable of integration, or connected to one
+  ROLE_BOUND,
+  // a source variable with an initial value which is differentiated
+  ROLE_STATE,
+  // a source variable with an initial value which is not differentiated
+  ROLE_PARAMETER,
+  // a source variable without an initial value
+  ROLE_COMPUTED,
+  // a variable which gets its value from another variable
+  ROLE_IMPORTED
+};
+
+/* A variable identified by its component name and its own name */
+typedef std::pair<std::wstring,std::wstring> VariableName;
+typedef std::vector<VariableName> VariableNameList;
+/* and by the IDs of those names */
+typedef NameIdPair VariableId;
+typedef std::vector<VariableId> VariableIdList;
+
+/* Everything we need to know about a source model variable, grabbed once.
+   The names are kept in the index's NamePool. */
+class VariableInfo
+{
+public:
+  ObjRef<iface::cellml_api::CellMLVariable> variable;
+  ObjRef<iface::cellml_api::CellMLVariable> source;
+  // the index entry for the source variable (possibly this entry)
+  const VariableInfo* sourceInfo;
+  NameId nameId;
+  NameId componentId;
+  NameId unitsId;
+  // NO_NAME if the variable has no initial value
+  NameId initialValueId;
+  VariableRole role;
+  // the variable's interfaces in the source model
+  iface::cellml_api::VariableInterface publicInterface;
+  iface::cellml_api::VariableInterface privateInterface;
+  // true if the variable's units are defined in its component
+  bool localUnits;
+  // for source variables, all the variables connected to this one
+  // (including itself)
+  VariableIdList connected;
+};
+typedef std::vector<const VariableInfo*> VariableInfoList;
+
+/* An index of the roles of all the variables in the relevant components of
+   a model, built once after the state variables and variables of
+   integration have been found so that later phases can look up any
+   variable without scanning lists or calling back into the CellML API.
+   The names of the variables and their components are interned in the
+   given pool. */
+class VariableRoleIndex
+{
+public:
+  VariableRoleIndex(NamePool& names);
+  ~VariableRoleIndex();
+  /* build the index for all variables in the relevant components, with the
+     connected variables for each source variable found using the CeVAS */
+  void build(iface::cellml_services::CeVAS* cevas,
+    const VariableList& stateVariables,const VariableList& boundVariables);
+  /* build the index for all variables in the given relevant components,
+     with the previously found sets of connected variables */
+  void build(
+    const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+    components,const VariableList& stateVariables,
+    const VariableList& boundVariables,
+    const std::vector<VariableNameList>& connectedSets);
+  /* find the entry for the given variable, or NULL if it isn't indexed */
+  const VariableInfo* find(iface::cellml_api::CellMLVariable* v) const;
+  /* find the entry for the identified variable, or NULL if it isn't
+     indexed */
+  const VariableInfo* find(const VariableId& id) const;
+  /* the entries for the variables of the given component, in document
+     order */
+  const VariableInfoList&
+  componentVariables(iface::cellml_api::CellMLComponent* c) const;
+  /* the relevant components, in the order CeVAS gives them */
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+  components() const
+  {
+    return mComponents;
+  }
+  size_t size() const
+  {
+    return mVariables.size();
+  }
+  /* the connected variable sets of all the source variables, by name */
+  void connectedSets(std::vector<VariableNameList>& sets) const;
+private:
+  void addComponents(
+    const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+    components,const VariableList& stateVariables,
+    const VariableList& boundVariables);
+  VariableInfo* addVariable(iface::cellml_api::CellMLVariable* v,
+    iface::cellml_api::CellMLComponent* c);
+  VariableRoleIndex(const VariableRoleIndex&);
+  VariableRoleIndex& operator=(const VariableRoleIndex&);
+
+  typedef std::unordered_map<iface::cellml_api::CellMLVariable*,
+                             VariableInfo> VariableMap;
+  typedef std::unordered_map<iface::cellml_api::CellMLComponent*,
+                             VariableInfoList> ComponentMap;
+  NamePool& mNames;
+  VariableMap mVariables;
+  // the entries keyed on their VariableId
+  std::unordered_map<uint64_t,VariableInfo*> mIds;
+  ComponentMap mComponentVariables;
+  std::vector< ObjRef<iface::cellml_api::CellMLComponent> > mComponents;
+  std::unordered_set<iface::cellml_api::CellMLVariable*> mState;
+  std::unordered_set<iface::cellml_api::CellMLVariable*> mBound;
+  VariableInfoList mEmpty;
+};
+
+#endif /* _ROLES_HPP_ */
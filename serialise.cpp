@@ -0,0 +1,264 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <stdlib.h>
+#include <wchar.h>
+
+#include <libxml/xmlwriter.h>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "namespaces.hpp"
+#include "serialise.hpp"
+#include "strings.hpp"
+
+
+#define XC(s) ((const xmlChar*)(s).c_str())
+
+/* The namespace prefixes currently in scope while writing a document */
+class NamespaceScope
+{
+public:
+  /* look up the namespace bound to the given prefix (empty for the default
+     namespace), returns false if the prefix isn't bound */
+  bool lookup(const std::wstring& prefix,std::wstring& ns) const
+  {
+    std::vector<std::pair<std::wstring,std::wstring> >::const_reverse_iterator
+      i = mBindings.rbegin();
+    for (;i!=mBindings.rend();++i)
+    {
+      if (i->first == prefix)
+      {
+        ns = i->second;
+        return true;
+      }
+    }
+    return false;
+  }
+  bool isBound(const std::wstring& prefix,const std::wstring& ns) const
+  {
+    std::wstring current;
+    if (!lookup(prefix,current)) return ns.empty();
+    return (current == ns);
+  }
+  void bind(const std::wstring& prefix,const std::wstring& ns)
+  {
+    mBindings.push_back(std::make_pair(prefix,ns));
+  }
+  size_t mark() const
+  {
+    return mBindings.size();
+  }
+  void release(size_t mark)
+  {
+    mBindings.resize(mark);
+  }
+private:
+  std::vector<std::pair<std::wstring,std::wstring> > mBindings;
+};
+
+/* get the prefix from a qualified name */
+static std::wstring prefixOf(const std::wstring& qname)
+{
+  size_t colon = qname.find(L':');
+  if (colon == std::wstring::npos) return L"";
+  return qname.substr(0,colon);
+}
+
+/* is the string all white space? */
+static bool isWhiteSpace(const std::wstring& str)
+{
+  return (str.find_first_not_of(L" \t\r\n") == std::wstring::npos);
+}
+
+static bool writeNode(iface::dom::Node* node,xmlTextWriterPtr writer,
+  NamespaceScope& scope);
+
+static bool writeElement(iface::dom::Node* node,xmlTextWriterPtr writer,
+  NamespaceScope& scope)
+{
+  size_t mark = scope.mark();
+  RETURN_INTO_WSTRING(qname,node->nodeName());
+  RETURN_INTO_WSTRING(ns,node->namespaceURI());
+  /* first sort out the attributes and namespace declarations */
+  std::vector<std::pair<std::wstring,std::wstring> > declarations;
+  std::vector<std::pair<std::wstring,std::wstring> > attributes;
+  RETURN_INTO_OBJREF(attrs,iface::dom::NamedNodeMap,node->attributes());
+  uint32_t i,l = attrs ? attrs->length() : 0;
+  for (i=0;i<l;++i)
+  {
+    RETURN_INTO_OBJREF(attr,iface::dom::Node,attrs->item(i));
+    RETURN_INTO_WSTRING(aname,attr->nodeName());
+    RETURN_INTO_WSTRING(avalue,attr->nodeValue());
+    RETURN_INTO_WSTRING(ans,attr->namespaceURI());
+    if ((ans == XMLNS_NS) || (aname == L"xmlns") ||
+      (aname.compare(0,6,L"xmlns:") == 0))
+    {
+      std::wstring prefix = (aname == L"xmlns") ? L"" : aname.substr(6);
+      if (!scope.isBound(prefix,avalue))
+      {
+        scope.bind(prefix,avalue);
+        declarations.push_back(std::make_pair(aname,avalue));
+      }
+    }
+    else
+    {
+      attributes.push_back(std::make_pair(aname,avalue));
+      // make sure any namespaced attributes have their prefix declared
+      std::wstring prefix = prefixOf(aname);
+      if (!prefix.empty() && !scope.isBound(prefix,ans))
+      {
+        scope.bind(prefix,ans);
+        declarations.push_back(std::make_pair(L"xmlns:" + prefix,ans));
+      }
+    }
+  }
+  // and the element's own namespace
+  std::wstring prefix = prefixOf(qname);
+  if (!scope.isBound(prefix,ns))
+  {
+    scope.bind(prefix,ns);
+    declarations.push_back(std::make_pair(prefix.empty() ? L"xmlns" :
+        L"xmlns:" + prefix,ns));
+  }
+  bool ok = (xmlTextWriterStartElement(writer,XC(wstringToUTF8(qname))) >= 0);
+  std::vector<std::pair<std::wstring,std::wstring> >::const_iterator a;
+  for (a=declarations.begin();ok && (a!=declarations.end());++a)
+  {
+    ok = (xmlTextWriterWriteAttribute(writer,XC(wstringToUTF8(a->first)),
+        XC(wstringToUTF8(a->second))) >= 0);
+  }
+  for (a=attributes.begin();ok && (a!=attributes.end());++a)
+  {
+    ok = (xmlTextWriterWriteAttribute(writer,XC(wstringToUTF8(a->first)),
+        XC(wstringToUTF8(a->second))) >= 0);
+  }
+  /* then the children */
+  RETURN_INTO_OBJREF(child,iface::dom::Node,node->firstChild());
+  while (ok && child)
+  {
+    ok = writeNode(child,writer,scope);
+    child = already_AddRefd<iface::dom::Node>(child->nextSibling());
+  }
+  if (ok) ok = (xmlTextWriterEndElement(writer) >= 0);
+  scope.release(mark);
+  return ok;
+}
+
+static bool writeNode(iface::dom::Node* node,xmlTextWriterPtr writer,
+  NamespaceScope& scope)
+{
+  switch (node->nodeType())
+  {
+  case iface::dom::Node::ELEMENT_NODE:
+    return writeElement(node,writer,scope);
+  case iface::dom::Node::TEXT_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      // leave the white space to the writer's indentation
+      if (isWhiteSpace(text)) return true;
+      return (xmlTextWriterWriteString(writer,XC(wstringToUTF8(text))) >= 0);
+    }
+  case iface::dom::Node::CDATA_SECTION_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      return (xmlTextWriterWriteCDATA(writer,XC(wstringToUTF8(text))) >= 0);
+    }
+  case iface::dom::Node::COMMENT_NODE:
+    {
+      RETURN_INTO_WSTRING(text,node->nodeValue());
+      return (xmlTextWriterWriteComment(writer,XC(wstringToUTF8(text))) >= 0);
+    }
+  case iface::dom::Node::PROCESSING_INSTRUCTION_NODE:
+    {
+      RETURN_INTO_WSTRING(target,node->nodeName());
+      RETURN_INTO_WSTRING(data,node->nodeValue());
+      return (xmlTextWriterWritePI(writer,XC(wstringToUTF8(target)),
+          XC(wstringToUTF8(data))) >= 0);
+    }
+  default:
+    // nothing else should turn up in our models
+    return true;
+  }
+}
+
+bool serialiseDocument(iface::dom::Document* doc,xmlTextWriterPtr writer)
+{
+  xmlTextWriterSetIndent(writer,1);
+  xmlTextWriterSetIndentString(writer,(const xmlChar*)"  ");
+  bool ok = (xmlTextWriterStartDocument(writer,NULL,"UTF-8",NULL) >= 0);
+  NamespaceScope scope;
+  RETURN_INTO_OBJREF(child,iface::dom::Node,doc->firstChild());
+  while (ok && child)
+  {
+    ok = writeNode(child,writer,scope);
+    child = already_AddRefd<iface::dom::Node>(child->nextSibling());
+  }
+  if (ok) ok = (xmlTextWriterEndDocument(writer) >= 0);
+  return ok;
+}
+
+bool serialiseModel(iface::cellml_api::Model* model,xmlTextWriterPtr writer)
+{
+  DECLARE_QUERY_INTERFACE(modelDE,model,cellml_api::CellMLDOMElement);
+  if (modelDE == NULL) return false;
+  RETURN_INTO_OBJREF(modelElement,iface::dom::Element,modelDE->domElement());
+  modelDE->release_ref();
+  RETURN_INTO_OBJREF(doc,iface::dom::Document,modelElement->ownerDocument());
+  return serialiseDocument(doc,writer);
+}
+
+bool serialiseModelToString(iface::cellml_api::Model* model,std::string& str)
+{
+  xmlBufferPtr buffer = xmlBufferCreate();
+  if (buffer == NULL) return false;
+  xmlTextWriterPtr writer = xmlNewTextWriterMemory(buffer,0);
+  if (writer == NULL)
+  {
+    xmlBufferFree(buffer);
+    return false;
+  }
+  bool ok = serialiseModel(model,writer);
+  // freeing the writer flushes everything into the buffer
+  xmlFreeTextWriter(writer);
+  if (ok)
+    str.assign((const char*)xmlBufferContent(buffer),xmlBufferLength(buffer));
+  xmlBufferFree(buffer);
+  return ok;
+}
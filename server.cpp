@@ -0,0 +1,314 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.hpp"
+#include "strings.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+
+/* the number of recent requests the latency percentiles are taken over */
+#define LATENCY_WINDOW 1000
+
+DecomposeServer::DecomposeServer(const DecomposeOptions& options,
+  const std::string& outputRoot,int concurrency) :
+  mOptions(options), mOutputRoot(outputRoot), mServed(0), mFailed(0),
+  mNextLatency(0)
+{
+  unsigned int slots = effectiveJobs(concurrency);
+  /* the memory use and its peak are only known for the whole process, so
+     can't be put down to one request when several are running at once */
+  if ((slots > 1) && (mOptions.memoryBudget || mOptions.memoryReport))
+  {
+    ReportLine(std::cerr) << "Memory reports and budgets need a concurrency "
+                          << "of 1, ignoring them";
+    mOptions.memoryBudget = 0;
+    mOptions.memoryReport = false;
+  }
+  for (unsigned int i=0;i<slots;++i)
+  {
+    mDecomposers.push_back(std::unique_ptr<Decomposer>(
+        new Decomposer(mOptions)));
+    mIdle.push_back(mDecomposers.back().get());
+  }
+}
+
+std::string DecomposeServer::handle(const std::string& request)
+{
+  std::istringstream fields(request);
+  std::string url, dir;
+  if (!(fields >> url)) return "FAILED: empty request";
+  if (url == "stats") return stats();
+  if (!(fields >> dir)) dir = defaultOutputDirectory(mOutputRoot,url);
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  // wait for one of the decomposition slots
+  Decomposer* decomposer;
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mIdle.empty()) mSlotFree.wait(lock);
+    decomposer = mIdle.back();
+    mIdle.pop_back();
+  }
+  int status = -1;
+  if (!makeDirectory(dir))
+  {
+    ReportLine(std::cerr) << "Unable to create output directory: " << dir;
+  }
+  else
+  {
+    try
+    {
+      status = decomposer->decomposeToDirectory(string2wstring(url.c_str()),
+        dir);
+    }
+    catch (...)
+    {
+      ReportLine(std::cerr) << "Unexpected exception decomposing model";
+      status = -1;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mIdle.push_back(decomposer);
+  }
+  mSlotFree.notify_one();
+  double ms = std::chrono::duration<double,std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+  record(status == 0,ms);
+  std::ostringstream reply;
+  reply << ((status == 0) ? "OK: " : "FAILED: ") << url << " " << ms;
+  return reply.str();
+}
+
+void DecomposeServer::record(bool ok,double ms)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  ++mServed;
+  if (!ok) ++mFailed;
+  if (mLatencies.size() < LATENCY_WINDOW) mLatencies.push_back(ms);
+  else mLatencies[mNextLatency] = ms;
+  mNextLatency = (mNextLatency + 1) % LATENCY_WINDOW;
+}
+
+std::string DecomposeServer::stats()
+{
+  std::vector<double> latencies;
+  std::ostringstream reply;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    latencies = mLatencies;
+    reply << "STATS: served=" << mServed << " failed=" << mFailed
+          << " active=" << (mDecomposers.size() - mIdle.size());
+  }
+  std::sort(latencies.begin(),latencies.end());
+  const int percentiles[] = { 50, 90, 99 };
+  for (size_t i=0;i<sizeof(percentiles)/sizeof(percentiles[0]);++i)
+  {
+    double ms = 0.0;
+    if (!latencies.empty())
+      ms = latencies[(latencies.size()-1)*percentiles[i]/100];
+    reply << " p" << percentiles[i] << "_ms=" << ms;
+  }
+  AnalysisCache* cache = mOptions.cache;
+  if (cache)
+  {
+    reply << " cache_hits=" << cache->hits() << " cache_misses="
+          << cache->misses();
+  }
+  return reply.str();
+}
+
+/* write all the given data to the file descriptor, returning false on
+   error */
+static bool writeAll(int fd,const std::string& data)
+{
+  size_t written = 0;
+  while (written < data.size())
+  {
+    ssize_t n = write(fd,data.data()+written,data.size()-written);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+int DecomposeServer::serveStream()
+{
+  /* the replies get stdout to themselves: anything else written to stdout
+     while decomposing, from any thread, goes to stderr instead */
+  std::cout.flush();
+  fflush(stdout);
+  int replies = dup(STDOUT_FILENO);
+  if ((replies < 0) || (dup2(STDERR_FILENO,STDOUT_FILENO) < 0))
+  {
+    std::cerr << "Unable to redirect stdout: " << strerror(errno)
+              << std::endl;
+    if (replies >= 0) close(replies);
+    return -1;
+  }
+  /* each worker reads its next request as soon as it is free, so up to the
+     concurrency limit requests are handled at once and the replies come
+     back in the order they are finished */
+  std::mutex inputMutex, outputMutex;
+  auto worker = [&]()
+  {
+    std::string line;
+    while (true)
+    {
+      {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        if (!std::getline(std::cin,line)) break;
+      }
+      if (line.empty() || (line[0] == '#')) continue;
+      std::string reply = handle(line);
+      std::lock_guard<std::mutex> lock(outputMutex);
+      writeAll(replies,reply + "\n");
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i=1;i<mDecomposers.size();++i)
+    threads.push_back(std::thread(worker));
+  worker();
+  for (size_t i=0;i<threads.size();++i) threads[i].join();
+  close(replies);
+  return 0;
+}
+
+/* write all the given data to the socket, returning false if the client
+   has gone away */
+static bool sendAll(int fd,const std::string& data)
+{
+  size_t sent = 0;
+  while (sent < data.size())
+  {
+    ssize_t n = send(fd,data.data()+sent,data.size()-sent,MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+void DecomposeServer::connection(int fd)
+{
+  std::string buffer;
+  char data[4096];
+  bool open = true;
+  while (open)
+  {
+    ssize_t n = recv(fd,data,sizeof(data),0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    buffer.append(data,n);
+    // handle each complete request line in turn
+    size_t eol;
+    while (open && ((eol = buffer.find('\n')) != std::string::npos))
+    {
+      std::string line = buffer.substr(0,eol);
+      buffer.erase(0,eol+1);
+      if (!line.empty() && (line[line.size()-1] == '\r'))
+        line.erase(line.size()-1);
+      if (line.empty() || (line[0] == '#')) continue;
+      open = sendAll(fd,handle(line) + "\n");
+    }
+  }
+  close(fd);
+}
+
+int DecomposeServer::serveSocket(const std::string& path)
+{
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    std::cerr << "Socket path too long: " << path << std::endl;
+    return -1;
+  }
+  int listener = socket(AF_UNIX,SOCK_STREAM,0);
+  if (listener < 0)
+  {
+    std::cerr << "Unable to create socket: " << strerror(errno) << std::endl;
+    return -1;
+  }
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path,path.c_str());
+  // replace the socket left behind by any previous server
+  unlink(path.c_str());
+  if ((bind(listener,(struct sockaddr*)&addr,sizeof(addr)) != 0) ||
+    (listen(listener,SOMAXCONN) != 0))
+  {
+    std::cerr << "Unable to listen on socket: " << path << ": "
+              << strerror(errno) << std::endl;
+    close(listener);
+    return -1;
+  }
+  std::cout << "Listening on socket: " << path << std::endl;
+  while (true)
+  {
+    int fd = accept(listener,NULL,NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      std::cerr << "Unable to accept connection: " << strerror(errno)
+                << std::endl;
+      break;
+    }
+    // each client gets its own thread, the decompositions are limited in
+    // handle()
+    std::thread(&DecomposeServer::connection,this,fd).detach();
+  }
+  close(listener);
+  unlink(path.c_str());
+  return -1;
+}
@@ -0,0 +1,91 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _SERVER_HPP_
+#define _SERVER_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "decomposer.hpp"
+
+/* A long running decomposition server, which keeps its Decomposers'
+   bootstrap objects (and any analysis cache) for all the requests it
+   serves. Each request is a line giving a model URL optionally followed by
+   the output directory for that model, as in a batch manifest, and the
+   reply is a line with either "OK: " or "FAILED: " followed by the URL and
+   the time taken in milliseconds. The request "stats" is answered with a
+   "STATS: " line giving the number of requests served, percentiles of the
+   recent latencies and the analysis cache hits and misses.
+
+   Up to the given number of models are decomposed at once, across all the
+   clients. The CellML API isn't thread safe, so each of these slots has a
+   Decomposer of its own and only the analysis cache is shared. */
+class DecomposeServer
+{
+public:
+  DecomposeServer(const DecomposeOptions& options,
+    const std::string& outputRoot,int concurrency);
+  /* serve the requests read from stdin, replying on stdout, until the end
+     of the input. Returns zero on success. */
+  int serveStream();
+  /* serve the requests from each connection to the given Unix domain
+     socket. Only returns on error. */
+  int serveSocket(const std::string& path);
+  /* handle a single request, returning the reply (without a newline) */
+  std::string handle(const std::string& request);
+  std::string stats();
+private:
+  void connection(int fd);
+  void record(bool ok,double ms);
+
+  DecomposeOptions mOptions;
+  std::string mOutputRoot;
+  // a Decomposer for each slot, and those not in use
+  std::vector< std::unique_ptr<Decomposer> > mDecomposers;
+  std::vector<Decomposer*> mIdle;
+  std::mutex mMutex;
+  std::condition_variable mSlotFree;
+  long mServed;
+  long mFailed;
+  // the most recent latencies, in milliseconds, as a ring buffer
+  std::vector<double> mLatencies;
+  size_t mNextLatency;
+};
+
+#endif /* _SERVER_HPP_ */
@@ -0,0 +1,155 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "strings.hpp"
+
+char* wstring2string(const wchar_t* str)
+{
+  if (str)
+  {
+    size_t len = wcsrtombs(NULL,&str,0,NULL);
+    if (len > 0)
+    {
+      len++;
+      char* s = (char*)malloc(len);
+      wcsrtombs(s,&str,len,NULL);
+      return(s);
+    }
+  }
+  return((char*)NULL);
+}
+
+std::string narrow(const std::wstring& str)
+{
+  std::string s;
+  char* cstr = wstring2string(str.c_str());
+  if (cstr)
+  {
+    s = cstr;
+    free(cstr);
+  }
+  return(s);
+}
+
+std::wstring string2wstring(const char* str)
+{
+  std::wstring ws;
+  size_t l = strlen(str);
+  wchar_t* wstr = new wchar_t[l + 1];
+  memset(wstr, 0, (l + 1) * sizeof(wchar_t));
+  const char* mbstr = str;
+  mbsrtowcs(wstr, &mbstr, l, NULL);
+  ws = wstr;
+  delete [] wstr;
+  return(ws);
+}
+
+std::string wstringToUTF8(const std::wstring& str)
+{
+  std::string s;
+  s.reserve(str.length());
+  for (size_t i=0;i<str.length();++i)
+  {
+    unsigned long c = (unsigned long)str[i];
+    // join up any UTF-16 surrogate pairs (for platforms with 16 bit wchar_t)
+    if ((c >= 0xD800) && (c <= 0xDBFF) && (i+1 < str.length()))
+    {
+      unsigned long c2 = (unsigned long)str[i+1];
+      if ((c2 >= 0xDC00) && (c2 <= 0xDFFF))
+      {
+        c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+        ++i;
+      }
+    }
+    if (c < 0x80) s += (char)c;
+    else if (c < 0x800)
+    {
+      s += (char)(0xC0 | (c >> 6));
+      s += (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+      s += (char)(0xE0 | (c >> 12));
+      s += (char)(0x80 | ((c >> 6) & 0x3F));
+      s += (char)(0x80 | (c & 0x3F));
+    }
+    else
+    {
+      s += (char)(0xF0 | (c >> 18));
+      s += (char)(0x80 | ((c >> 12) & 0x3F));
+      s += (char)(0x80 | ((c >> 6) & 0x3F));
+      s += (char)(0x80 | (c & 0x3F));
+    }
+  }
+  return(s);
+}
+
+bool UTF8ToWstring(const std::string& str,std::wstring& ws)
+{
+  ws.clear();
+  ws.reserve(str.length());
+  size_t i = 0;
+  while (i < str.length())
+  {
+    unsigned long c = (unsigned char)str[i++];
+    int more = 0;
+    if (c >= 0xF0) more = 3;
+    else if (c >= 0xE0) more = 2;
+    else if (c >= 0xC0) more = 1;
+    else if (c >= 0x80) return false;
+    if (more) c &= (0x3F >> more);
+    if (i + more > str.length()) return false;
+    for (;more>0;--more)
+    {
+      unsigned long c2 = (unsigned char)str[i++];
+      if ((c2 & 0xC0) != 0x80) return false;
+      c = (c << 6) | (c2 & 0x3F);
+    }
+    // split anything outside the BMP into a surrogate pair where wchar_t
+    // is only 16 bits
+    if ((sizeof(wchar_t) == 2) && (c >= 0x10000))
+    {
+      c -= 0x10000;
+      ws += (wchar_t)(0xD800 + (c >> 10));
+      ws += (wchar_t)(0xDC00 + (c & 0x3FF));
+    }
+    else ws += (wchar_t)c;
+  }
+  return true;
+}
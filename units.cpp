@@ -0,0 +1,129 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <vector>
+#include <set>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "namespaces.hpp"
+#include "units.hpp"
+
+static bool isCellML(const std::wstring& ns)
+{
+  return ((ns == CELLML_1_0_NS) || (ns == CELLML_1_1_NS));
+}
+
+void findUnitsReferences(iface::dom::Node* node,
+  std::set<std::wstring>& names)
+{
+  if (node->nodeType() != iface::dom::Node::ELEMENT_NODE) return;
+  RETURN_INTO_WSTRING(ns,node->namespaceURI());
+  bool cellmlElement = isCellML(ns);
+  RETURN_INTO_OBJREF(attrs,iface::dom::NamedNodeMap,node->attributes());
+  uint32_t i,l = attrs ? attrs->length() : 0;
+  for (i=0;i<l;++i)
+  {
+    RETURN_INTO_OBJREF(attr,iface::dom::Node,attrs->item(i));
+    RETURN_INTO_WSTRING(aname,attr->localName());
+    if (aname != L"units") continue;
+    // the units attribute of a variable or unit element, or cellml:units
+    RETURN_INTO_WSTRING(ans,attr->namespaceURI());
+    if ((ans.empty() && cellmlElement) || isCellML(ans))
+    {
+      RETURN_INTO_WSTRING(value,attr->nodeValue());
+      names.insert(value);
+    }
+  }
+  RETURN_INTO_OBJREF(child,iface::dom::Node,node->firstChild());
+  while (child)
+  {
+    findUnitsReferences(child,names);
+    child = already_AddRefd<iface::dom::Node>(child->nextSibling());
+  }
+}
+
+bool UnitsDependencies::add(const std::wstring& name,iface::dom::Node* units)
+{
+  if (mIndex.find(name) != mIndex.end()) return false;
+  mIndex[name] = mNames.size();
+  mNames.push_back(name);
+  mReferences.push_back(std::set<std::wstring>());
+  findUnitsReferences(units,mReferences.back());
+  return true;
+}
+
+std::vector<std::wstring>
+UnitsDependencies::required(iface::dom::Node* node) const
+{
+  std::set<std::wstring> references;
+  findUnitsReferences(node,references);
+  return required(references);
+}
+
+std::vector<std::wstring>
+UnitsDependencies::required(const std::set<std::wstring>& references) const
+{
+  // follow the references through the units definitions
+  std::vector<bool> needed(mNames.size(),false);
+  std::vector<size_t> pending;
+  std::set<std::wstring>::const_iterator r = references.begin();
+  for (;r!=references.end();++r)
+  {
+    std::unordered_map<std::wstring,size_t>::const_iterator i =
+      mIndex.find(*r);
+    // anything else is a built-in or component-scope units
+    if (i == mIndex.end() || needed[i->second]) continue;
+    needed[i->second] = true;
+    pending.push_back(i->second);
+  }
+  while (!pending.empty())
+  {
+    size_t u = pending.back();
+    pending.pop_back();
+    for (r=mReferences[u].begin();r!=mReferences[u].end();++r)
+    {
+      std::unordered_map<std::wstring,size_t>::const_iterator i =
+        mIndex.find(*r);
+      if (i == mIndex.end() || needed[i->second]) continue;
+      needed[i->second] = true;
+      pending.push_back(i->second);
+    }
+  }
+  std::vector<std::wstring> names;
+  for (size_t i=0;i<mNames.size();++i) if (needed[i]) names.push_back(mNames[i]);
+  return names;
+}
@@ -0,0 +1,79 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _UNITS_HPP_
+#define _UNITS_HPP_
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+/* Add the names of all the units referenced by the given DOM node and its
+   descendants to the set: the units of variables, the units each unit of a
+   units definition is based on and the cellml:units of MathML numbers */
+void findUnitsReferences(iface::dom::Node* node,
+  std::set<std::wstring>& names);
+
+/* The model-scope units of the source model and the units each of them is
+   defined in terms of, so we can work out which units each new model needs
+   to import */
+class UnitsDependencies
+{
+public:
+  /* add a model-scope units definition, returning false if units with the
+     same name have already been added */
+  bool add(const std::wstring& name,iface::dom::Node* units);
+  /* the model-scope units the given node needs: those it references and
+     all the units they depend on, in the order the units were added */
+  std::vector<std::wstring> required(iface::dom::Node* node) const;
+  /* the same, given the names of the units referenced */
+  std::vector<std::wstring>
+  required(const std::set<std::wstring>& references) const;
+  size_t size() const
+  {
+    return mNames.size();
+  }
+private:
+  std::vector<std::wstring> mNames;
+  std::unordered_map<std::wstring,size_t> mIndex;
+  // the names each units definition references, resolved once all the
+  // units are known
+  std::vector< std::set<std::wstring> > mReferences;
+};
+
+#endif /* _UNITS_HPP_ */
@@ -0,0 +1,196 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "utils.hxx"
+#include "usage.hpp"
+#include "classify.hpp"
+#include "namespaces.hpp"
+
+/* an equation in the math of a relevant component */
+class UsageEquation
+{
+public:
+  // the computed variable it defines, NULL if it must always be kept
+  const VariableInfo* defines;
+  // the variables it reads
+  VariableInfoList reads;
+};
+
+VariableUsage::VariableUsage(const VariableRoleIndex& index,NamePool& names) :
+  mIndex(index), mNames(names), mUnusedEquations(0)
+{
+  std::vector<UsageEquation> equations;
+  std::unordered_map<const VariableInfo*,std::vector<size_t> > definitions;
+  std::vector<size_t> pendingEquations;
+  VariableInfoList pendingVariables, computed;
+  bool haveStates = false;
+  const std::vector< ObjRef<iface::cellml_api::CellMLComponent> >&
+    components = index.components();
+  std::vector< ObjRef<iface::cellml_api::CellMLComponent> >::const_iterator
+    c = components.begin();
+  for (;c!=components.end();++c)
+  {
+    RETURN_INTO_WSTRING(cname,(*c)->name());
+    NameId component = names.intern(cname);
+    // the values of the state variables and variables of integration are
+    // what the simulation is for
+    const VariableInfoList& variables = index.componentVariables(*c);
+    VariableInfoList::const_iterator v = variables.begin();
+    for (;v!=variables.end();++v)
+    {
+      if ((*v)->sourceInfo != *v) continue;
+      if ((*v)->role == ROLE_STATE) haveStates = true;
+      if (((*v)->role == ROLE_STATE) || ((*v)->role == ROLE_BOUND))
+        pendingVariables.push_back(*v);
+      else if ((*v)->role == ROLE_COMPUTED) computed.push_back(*v);
+    }
+    // and each equation reads every variable it references, apart from
+    // the one it defines
+    RETURN_INTO_OBJREF(math,iface::cellml_api::MathList,(*c)->math());
+    RETURN_INTO_OBJREF(mathIt,iface::cellml_api::MathMLElementIterator,
+      math->iterate());
+    while (true)
+    {
+      RETURN_INTO_OBJREF(m,iface::mathml_dom::MathMLElement,mathIt->next());
+      if (m == NULL) break;
+      RETURN_INTO_OBJREF(e,iface::dom::Node,m->firstChild());
+      for (;e;e=already_AddRefd<iface::dom::Node>(e->nextSibling()))
+      {
+        if (e->nodeType() != iface::dom::Node::ELEMENT_NODE) continue;
+        UsageEquation equation;
+        equation.defines = definition(e,component);
+        std::set<std::wstring> references;
+        findVariableReferences(e,references);
+        if (equation.defines)
+          references.erase(names.name(equation.defines->nameId));
+        std::set<std::wstring>::const_iterator r = references.begin();
+        for (;r!=references.end();++r)
+        {
+          const VariableInfo* read =
+            index.find(VariableId(component,names.intern(*r)));
+          if (read) equation.reads.push_back(read);
+        }
+        if (equation.defines)
+          definitions[equation.defines].push_back(equations.size());
+        else pendingEquations.push_back(equations.size());
+        equations.push_back(equation);
+      }
+    }
+  }
+  if (!haveStates)
+    pendingVariables.insert(pendingVariables.end(),computed.begin(),
+      computed.end());
+  /* follow the equations and connections from everything needed so far */
+  std::vector<bool> kept(equations.size(),false);
+  size_t keptCount = 0;
+  while (!pendingEquations.empty() || !pendingVariables.empty())
+  {
+    if (!pendingEquations.empty())
+    {
+      size_t e = pendingEquations.back();
+      pendingEquations.pop_back();
+      if (kept[e]) continue;
+      kept[e] = true;
+      keptCount++;
+      VariableInfoList::const_iterator r = equations[e].reads.begin();
+      for (;r!=equations[e].reads.end();++r)
+      {
+        mRead.insert(*r);
+        if ((*r)->sourceInfo) pendingVariables.push_back((*r)->sourceInfo);
+      }
+      continue;
+    }
+    const VariableInfo* v = pendingVariables.back();
+    pendingVariables.pop_back();
+    if (!mNeeded.insert(v).second) continue;
+    std::unordered_map<const VariableInfo*,std::vector<size_t> >::
+      const_iterator d = definitions.find(v);
+    if (d != definitions.end())
+      pendingEquations.insert(pendingEquations.end(),d->second.begin(),
+        d->second.end());
+  }
+  mUnusedEquations = equations.size() - keptCount;
+}
+
+bool VariableUsage::used(const VariableInfo* v) const
+{
+  // a connected variable is only needed by its own component's math
+  if (v->sourceInfo != v) return (mRead.count(v) != 0);
+  if ((v->role == ROLE_COMPUTED) || (v->role == ROLE_PARAMETER))
+    return (mNeeded.count(v) != 0);
+  return true;
+}
+
+void VariableUsage::removeUnusedEquations(iface::dom::Node* math,
+  const std::wstring& component) const
+{
+  RETURN_INTO_WSTRING(ns,math->namespaceURI());
+  RETURN_INTO_WSTRING(localName,math->localName());
+  if ((ns != MATHML_NS) || (localName != L"math")) return;
+  NameId componentId = mNames.intern(component);
+  std::vector< ObjRef<iface::dom::Node> > unused;
+  RETURN_INTO_OBJREF(e,iface::dom::Node,math->firstChild());
+  for (;e;e=already_AddRefd<iface::dom::Node>(e->nextSibling()))
+  {
+    if (e->nodeType() != iface::dom::Node::ELEMENT_NODE) continue;
+    const VariableInfo* v = definition(e,componentId);
+    if (v && (mNeeded.count(v) == 0)) unused.push_back(e);
+  }
+  std::vector< ObjRef<iface::dom::Node> >::const_iterator u = unused.begin();
+  for (;u!=unused.end();++u)
+  {
+    RETURN_INTO_OBJREF(removed,iface::dom::Node,math->removeChild(*u));
+  }
+}
+
+const VariableInfo* VariableUsage::definition(iface::dom::Node* equation,
+  NameId component) const
+{
+  std::wstring name = definedVariable(equation);
+  if (name.empty()) return NULL;
+  /* only the component's own computed variables are defined this way,
+     anything else is treated like any other equation */
+  const VariableInfo* v =
+    mIndex.find(VariableId(component,mNames.intern(name)));
+  if (!v || (v->sourceInfo != v) || (v->role != ROLE_COMPUTED)) return NULL;
+  return v;
+}
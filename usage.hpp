@@ -0,0 +1,89 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is decompose.
+ *
+ * The Initial Developer of the Original Code is
+ * David Nickerson <nickerso@users.sourceforge.net>.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+#ifndef _USAGE_HPP_
+#define _USAGE_HPP_
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+#include <IfaceCellML_APISPEC.hxx>
+
+#include "names.hpp"
+#include "roles.hpp"
+
+/* Which of the variables and equations in the relevant components of a
+   model are needed to simulate it. Starting from the state variables, the
+   variables of integration and every equation which doesn't simply define
+   a computed variable, the math and the connections are followed to each
+   source variable whose value is read and on to the equations defining it.
+   A computed variable or parameter which isn't reached, the equations
+   defining it and any connected variable its component's remaining math
+   doesn't read can all be left out. A model without state variables has
+   nothing to start from, so only its unread parameters and connected
+   variables go. */
+class VariableUsage
+{
+public:
+  VariableUsage(const VariableRoleIndex& index,NamePool& names);
+  /* should the given variable be kept in its new component? */
+  bool used(const VariableInfo* v) const;
+  /* remove the equations which aren't needed from the given node, if it is
+     a math element imported from the named component */
+  void removeUnusedEquations(iface::dom::Node* math,
+    const std::wstring& component) const;
+  size_t unusedEquations() const
+  {
+    return mUnusedEquations;
+  }
+private:
+  /* the computed variable defined by the given equation in the named
+     component, or NULL if it defines anything else */
+  const VariableInfo* definition(iface::dom::Node* equation,
+    NameId component) const;
+  VariableUsage(const VariableUsage&);
+  VariableUsage& operator=(const VariableUsage&);
+
+  const VariableRoleIndex& mIndex;
+  NamePool& mNames;
+  // the source variables whose values are needed
+  std::unordered_set<const VariableInfo*> mNeeded;
+  // the variables read by the equations which are kept
+  std::unordered_set<const VariableInfo*> mRead;
+  size_t mUnusedEquations;
+};
+
+#endif /* _USAGE_HPP_ */
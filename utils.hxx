@@ -111,6 +111,29 @@
     variable(Variable::NONE);                                             \
   else ERROR("CELLML_TO_VARIABLE_INTERFACE","Invalid variable interface\n")
 
+/* Building with DECOMPOSE_COUNT_REFS defined counts the add_ref and
+   release_ref calls made by ObjRef, to see what the reference counting in a
+   run costs */
+#ifdef DECOMPOSE_COUNT_REFS
+#include <atomic>
+
+class ObjRefCounts
+{
+public:
+  std::atomic<long> addRefs;
+  std::atomic<long> releaseRefs;
+};
+
+inline ObjRefCounts& objRefCounts()
+{
+  static ObjRefCounts counts;
+  return counts;
+}
+#define OBJREF_COUNT(counter) ++(objRefCounts().counter)
+#else
+#define OBJREF_COUNT(counter)
+#endif
+
 template<class T>
 class already_AddRefd
 {
@@ -150,13 +173,21 @@ public:
   {
     mPtr = aPtr.getPointer();
     if (mPtr != NULL)
-      mPtr->add_ref();
+      addRef(mPtr);
+  }
+
+  // taking over the reference, so moving ObjRefs around (including in
+  // growing vectors) doesn't touch the reference count
+  ObjRef(ObjRef<T>&& aPtr) noexcept
+    : mPtr(aPtr.mPtr)
+  {
+    aPtr.mPtr = NULL;
   }
 
   ObjRef(T* aPtr)
     : mPtr(aPtr)
   {
-    mPtr->add_ref();
+    addRef(mPtr);
   }
 
   ObjRef(const already_AddRefd<T> aar)
@@ -167,7 +198,7 @@ public:
   ~ObjRef()
   {
     if (mPtr != NULL)
-      mPtr->release_ref();
+      releaseRef(mPtr);
   }
 
   T* operator-> () const
@@ -190,10 +221,10 @@ public:
     if (mPtr == newAssign)
       return;
     if (mPtr)
-      mPtr->release_ref();
+      releaseRef(mPtr);
     mPtr = newAssign;
     if (newAssign != NULL)
-      mPtr->add_ref();
+      addRef(mPtr);
   }
 
   // We need these explicit forms or the default overloads the templates below.
@@ -203,20 +234,31 @@ public:
     if (mPtr == nap)
       return;
     if (mPtr)
-      mPtr->release_ref();
+      releaseRef(mPtr);
     mPtr = nap;
   }
 
+  void operator= (ObjRef<T>&& newAssign) noexcept
+  {
+    if (this == &newAssign)
+      return;
+    T* old = mPtr;
+    mPtr = newAssign.mPtr;
+    newAssign.mPtr = NULL;
+    if (old)
+      releaseRef(old);
+  }
+
   void operator= (const ObjRef<T>& newAssign)
   {
     T* nap = newAssign.getPointer();
     if (mPtr == nap)
       return;
     if (mPtr)
-      mPtr->release_ref();
+      releaseRef(mPtr);
     mPtr = nap;
     if (mPtr != NULL)
-      mPtr->add_ref();
+      addRef(mPtr);
   }
 
   template<class U>
@@ -226,7 +268,7 @@ public:
     if (mPtr == nap)
       return;
     if (mPtr)
-      mPtr->release_ref();
+      releaseRef(mPtr);
     mPtr = nap;
   }
 
@@ -237,10 +279,64 @@ public:
     if (mPtr == nap)
       return;
     if (mPtr)
-      mPtr->release_ref();
+      releaseRef(mPtr);
     mPtr = nap;
     if (mPtr != NULL)
-      mPtr->add_ref();
+      addRef(mPtr);
+  }
+
+private:
+  static void addRef(T* ptr)
+  {
+    OBJREF_COUNT(addRefs);
+    ptr->add_ref();
+  }
+
+  static void releaseRef(T* ptr)
+  {
+    OBJREF_COUNT(releaseRefs);
+    ptr->release_ref();
+  }
+
+  T* mPtr;
+};
+
+/* A non-owning reference to an object which is kept alive by an ObjRef (or
+   some other reference) elsewhere, for access inside loops and to long lived
+   objects without an add_ref/release_ref pair each time. It must not
+   outlive the reference it was taken from. */
+template<class T>
+class BorrowedRef
+{
+public:
+  BorrowedRef()
+    : mPtr(NULL)
+  {
+  }
+
+  BorrowedRef(T* aPtr)
+    : mPtr(aPtr)
+  {
+  }
+
+  BorrowedRef(const ObjRef<T>& aRef)
+    : mPtr(aRef.getPointer())
+  {
+  }
+
+  T* operator-> () const
+  {
+    return mPtr;
+  }
+
+  T* getPointer() const
+  {
+    return mPtr;
+  }
+
+  operator T* () const
+  {
+    return mPtr;
   }
 
 private: